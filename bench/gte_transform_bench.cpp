@@ -0,0 +1,110 @@
+// GTE style fixed point transform benchmark
+//
+// usage: gte_transform_bench [vertices] [runs]
+// Random vertices (default 1M) in front of the camera, transformed and
+// projected to 320x240 pixels three ways: per vertex float glm::mat4 with the
+// perspective divide, the scalar fixed point reference and the SIMD batch
+// GteTransform (AVX2 or SSE2, whatever the build enables). The SIMD results
+// must equal the scalar ones; the difference to the float path shows the cost
+// of the fixed point snapping. The float loop auto-vectorizes with -O3 and
+// AVX2 enabled, so the ratio depends on the build: the flags are printed.
+#define SDL_MAIN_HANDLED
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "gte_transform.hpp"
+
+int main(int argc, char** argv)
+{
+    size_t count = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    int runs = (argc > 2) ? std::atoi(argv[2]) : 20;
+    const int width = 320, height = 240;
+    const float vertexScale = 256.0f; // 1.0 = 256 units, +-128 world units
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> xy(-20.0f, 20.0f), depth(-60.0f, -2.0f);
+    std::vector<glm::vec3> positions(count);
+    for (glm::vec3& p : positions)
+        p = glm::vec3(xy(rng), xy(rng) * 0.75f, depth(rng)); // object space = view space, mostly on screen
+
+    const float fovY = glm::radians(45.0f);
+    glm::mat4 model = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, -0.25f, -1.0f)), 0.3f, glm::vec3(0, 1, 0));
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 mvp = glm::perspective(fovY, float(width) / height, 0.1f, 100.0f) * view * model;
+
+    GteVertices vertices;
+    GteQuantizeVertices(positions, vertexScale, vertices);
+    GteMatrix matrix = GteMatrixFromGL(view * model, vertexScale);
+    GteProjection projection = GteProjectionFor(fovY, width, height);
+
+    std::vector<int16_t> floatX(count), floatY(count);
+    GteScreen scalar, simd;
+    scalar.resize(count);
+
+    double bestFloat = 1e30, bestScalar = 1e30, bestSimd = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++) {
+            glm::vec4 clip = mvp * glm::vec4(positions[i], 1.0f);
+            float invW = 1.0f / clip.w;
+            floatX[i] = static_cast<int16_t>(std::floor((clip.x * invW * 0.5f + 0.5f) * width));
+            floatY[i] = static_cast<int16_t>(std::floor((0.5f - clip.y * invW * 0.5f) * height));
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        GteTransformScalar(matrix, projection, vertices, 0, count, scalar);
+        auto t2 = std::chrono::steady_clock::now();
+        GteTransform(matrix, projection, vertices, simd);
+        auto t3 = std::chrono::steady_clock::now();
+
+        bestFloat = std::min(bestFloat, std::chrono::duration<double, std::milli>(t1 - t0).count());
+        bestScalar = std::min(bestScalar, std::chrono::duration<double, std::milli>(t2 - t1).count());
+        bestSimd = std::min(bestSimd, std::chrono::duration<double, std::milli>(t3 - t2).count());
+    }
+
+    size_t mismatches = 0, onScreen = 0;
+    int maxError = 0;
+    double sumError = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        mismatches += simd.sx[i] != scalar.sx[i] || simd.sy[i] != scalar.sy[i] || simd.sz[i] != scalar.sz[i];
+        if (floatX[i] < 0 || floatX[i] >= width || floatY[i] < 0 || floatY[i] >= height)
+            continue;
+        int error = std::max(std::abs(simd.sx[i] - floatX[i]), std::abs(simd.sy[i] - floatY[i]));
+        maxError = std::max(maxError, error);
+        sumError += error;
+        onScreen++;
+    }
+
+    auto rate = [&](double ms) { return count / (ms * 1000.0); };
+#if defined(__VERSION__)
+    const char* compiler = __VERSION__;
+#else
+    const char* compiler = "unknown compiler";
+#endif
+#if defined(__OPTIMIZE__)
+    const char* optimized = "optimized";
+#else
+    const char* optimized = "not optimized";
+#endif
+#if defined(GTE_AVX2)
+    const char* path = "AVX2";
+#elif defined(GTE_SSE)
+    const char* path = "SSE2";
+#else
+    const char* path = "none";
+#endif
+    std::printf("Build: %s, %s, SIMD %s\n", compiler, optimized, path);
+    std::printf("%zu vertices, best of %d runs\n", count, runs);
+    std::printf("  float glm::mat4   %8.3f ms  %7.1f Mvertices/s\n", bestFloat, rate(bestFloat));
+    std::printf("  fixed scalar      %8.3f ms  %7.1f Mvertices/s\n", bestScalar, rate(bestScalar));
+    std::printf("  fixed %-4s        %8.3f ms  %7.1f Mvertices/s  (%.2fx float)\n", path, bestSimd, rate(bestSimd),
+                bestFloat / bestSimd);
+    std::printf("SIMD vs scalar: %zu mismatches\n", mismatches);
+    std::printf("Fixed vs float on screen: max %d px, mean %.3f px over %zu vertices\n", maxError,
+                onScreen ? sumError / onScreen : 0.0, onScreen);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// OBJ parser throughput benchmark
+//
+// usage: obj_loader_bench [file.obj | grid size] [runs] [max threads]
+// Without a file a triangulated N x N grid (default 512) is generated and parsed,
+// which is close to what our exported level meshes look like. The file is parsed
+// with 1..max threads (default: one per core) to show the scaling of the chunked parser.
+#define SDL_MAIN_HANDLED
+
+#include <GL/glew.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "obj_loader.hpp"
+
+static std::string writeGridOBJ(int n)
+{
+    std::string path = "bench_grid_" + std::to_string(n) + ".obj";
+    std::ofstream out(path);
+    out << "# generated " << n << "x" << n << " grid\nmtllib cube.mtl\nusemtl texture\n";
+
+    for (int z = 0; z <= n; z++)
+        for (int x = 0; x <= n; x++) {
+            out << "v " << x * 0.25f << " " << ((x * 7 + z * 13) % 17) * 0.01f << " " << z * 0.25f << "\n";
+            out << "vt " << x / float(n) << " " << z / float(n) << "\n";
+        }
+    out << "vn 0.0 1.0 0.0\n";
+
+    for (int z = 0; z < n; z++)
+        for (int x = 0; x < n; x++) {
+            int a = z * (n + 1) + x + 1;
+            int b = a + 1;
+            int c = a + n + 1;
+            int d = c + 1;
+            out << "f " << a << "/" << a << "/1 " << c << "/" << c << "/1 " << d << "/" << d << "/1\n";
+            out << "f " << a << "/" << a << "/1 " << d << "/" << d << "/1 " << b << "/" << b << "/1\n";
+        }
+    return path;
+}
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    bool generated = false;
+    int runs = (argc > 2) ? std::atoi(argv[2]) : 5;
+
+    if (argc > 1 && std::string(argv[1]).find(".obj") != std::string::npos) {
+        path = argv[1];
+    } else {
+        int n = (argc > 1) ? std::atoi(argv[1]) : 512;
+        path = writeGridOBJ(n);
+        generated = true;
+    }
+
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Cannot open " << path << "\n";
+        return 1;
+    }
+
+    unsigned int maxThreads = (argc > 3) ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+    maxThreads = std::max(1u, maxThreads);
+
+    double mb = file.size / (1024.0 * 1024.0);
+    double serial = 0.0;
+
+    for (unsigned int threads = 1; threads <= maxThreads; threads++) {
+        double best = 1e30;
+        size_t faces = 0;
+        for (int i = 0; i < runs; i++) {
+            auto t0 = std::chrono::steady_clock::now();
+            Mesh mesh;
+            ParseOBJ(file.data, file.size, mesh, threads);
+            auto t1 = std::chrono::steady_clock::now();
+
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+            faces = mesh.indices.size() / 3;
+        }
+        if (threads == 1) {
+            serial = best;
+            std::printf("%s: %.1f MB, %zu faces, best of %d runs\n", path.c_str(), mb, faces, runs);
+        }
+        std::printf("  %2u threads: %8.2f ms  %8.1f MB/s  %6.2f Mfaces/s  x%.2f\n",
+                    threads, best * 1e3, mb / best, faces / best * 1e-6, serial / best);
+    }
+
+    file.close();
+    if (generated)
+        std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Software rasterizer span loop benchmark
+//
+// usage: software_raster_spans_bench [frames]
+// The same overlapping, textured and lit grid drawn at 320x240 with every
+// combination of span state bits, once through the template instantiation
+// from the dispatch table and once through the generic loop that tests the
+// state bits per pixel. Both must produce the same image; raster times are
+// the best frame of each, single threaded.
+#define SDL_MAIN_HANDLED
+
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// stb_image implementation (obj_loader.hpp has it in the app)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+
+#include "software_rasterizer.hpp"
+
+static std::string stateName(uint32_t state)
+{
+    static const char* names[] = { "tex", "gouraud", "ztest", "zwrite", "blend", "dither" };
+    std::string name;
+    for (int bit = 0; bit < 6; bit++)
+        if (state & (1u << bit))
+            name += (name.empty() ? "" : "+") + std::string(names[bit]);
+    return name.empty() ? "flat" : name;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = (argc > 1) ? std::atoi(argv[1]) : 30;
+
+    std::vector<uint32_t> texels;
+    for (int y = 0; y < 64; y++)
+        for (int x = 0; x < 64; x++)
+            texels.push_back(((x / 8 + y / 8) & 1) ? PackARGB(200, 160, 90, 255) : PackARGB(60, 90, 40, 200));
+    SoftwareTexture texture;
+    texture.create(64, 64, texels, SOFTWARE_TEXTURE_MORTON);
+
+    // 48 x 48 quads, bumpy so the normals vary
+    const int n = 48;
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texcoords;
+    std::vector<unsigned int> indices;
+    for (int z = 0; z <= n; z++)
+        for (int x = 0; x <= n; x++) {
+            float fx = x / float(n) * 2.0f - 1.0f, fz = z / float(n) * 2.0f - 1.0f;
+            positions.push_back(glm::vec3(fx, 0.1f * std::sin(fx * 9.0f) * std::cos(fz * 7.0f), fz));
+            normals.push_back(glm::normalize(glm::vec3(-0.9f * std::cos(fx * 9.0f) * std::cos(fz * 7.0f), 1.0f,
+                                                       0.7f * std::sin(fx * 9.0f) * std::sin(fz * 7.0f))));
+            texcoords.push_back(glm::vec2(x / float(n) * 4.0f, z / float(n) * 4.0f));
+        }
+    for (int z = 0; z < n; z++)
+        for (int x = 0; x < n; x++) {
+            unsigned int a = z * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+            indices.insert(indices.end(), { a, c, d, a, d, b });
+        }
+
+    // three layers of the grid, the screen is covered about twice
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.6f, 1.2f), glm::vec3(0.0f, 0.0f, -0.2f), glm::vec3(0, 1, 0));
+    std::vector<SoftwareDraw> draws;
+    for (int layer = 0; layer < 3; layer++) {
+        SoftwareDraw draw;
+        draw.positions = positions.data();
+        draw.texcoords = texcoords.data();
+        draw.normals = normals.data();
+        draw.indices = indices.data();
+        draw.indexCount = indices.size();
+        draw.mvp = projection * view * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.15f * layer, -0.1f * layer));
+        draw.texture = &texture;
+        draw.color = PackARGB(180, 180, 220, 255);
+        draw.alpha = 160;
+        draw.light = glm::normalize(glm::vec3(0.4f, 1.0f, 0.3f));
+        draw.ambient = 0.3f;
+        draws.push_back(draw);
+    }
+
+    SoftwareRasterizer raster;
+    raster.resize(320, 240);
+
+    std::printf("%zu triangles x %zu draws, 320x240, best of %d frames\n", indices.size() / 3, draws.size(), frames);
+    std::printf("%-40s %10s %10s %8s\n", "state", "generic", "template", "speedup");
+    double totalGeneric = 0.0, totalTemplate = 0.0;
+    size_t mismatches = 0;
+    // VRAM sampling is covered by vram_bench
+    for (uint32_t state = 0; state < RASTER_VRAM; state++) {
+        for (SoftwareDraw& draw : draws)
+            draw.state = state;
+
+        double best[2] = { 1e30, 1e30 };
+        std::vector<uint32_t> images[2];
+        for (int specialized = 0; specialized < 2; specialized++) {
+            raster.specializedSpans = specialized != 0;
+            for (int f = 0; f < frames; f++) {
+                raster.render(draws, nullptr);
+                best[specialized] = std::min(best[specialized], raster.stats.rasterMs);
+            }
+            images[specialized] = raster.color;
+        }
+        mismatches += images[0] != images[1];
+        totalGeneric += best[0];
+        totalTemplate += best[1];
+        std::printf("%-40s %8.3f ms %8.3f ms %7.2fx%s\n", stateName(state).c_str(), best[0], best[1],
+                    best[0] / best[1], images[0] != images[1] ? "  MISMATCH" : "");
+    }
+    std::printf("all states: generic %.3f ms, template %.3f ms, %.2fx; %zu mismatching images\n",
+                totalGeneric, totalTemplate, totalGeneric / totalTemplate, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// Software rasterizer benchmark
+//
+// usage: software_rasterizer_bench [triangles] [frames] [max threads]
+// A textured terrain grid with about the given number of triangles (default
+// 8000) seen from a moving camera at 320x240, rendered with 1..max threads
+// (default: one per core). Also checks the fill convention: a blended grid
+// covering the whole screen must touch every pixel exactly once.
+#define SDL_MAIN_HANDLED
+
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+// stb_image implementation (obj_loader.hpp has it in the app)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+
+#include "software_rasterizer.hpp"
+
+// n x n quads in [-1, 1]^2 at y = height(x, z)
+static void makeGrid(int n, float scale, bool bumpy, std::vector<glm::vec3>& positions,
+                     std::vector<glm::vec2>& texcoords, std::vector<unsigned int>& indices)
+{
+    for (int z = 0; z <= n; z++)
+        for (int x = 0; x <= n; x++) {
+            float fx = (x / float(n) * 2.0f - 1.0f) * scale, fz = (z / float(n) * 2.0f - 1.0f) * scale;
+            float h = bumpy ? 0.4f * std::sin(fx * 0.7f) * std::cos(fz * 0.5f) : 0.0f;
+            positions.push_back(glm::vec3(fx, h, fz));
+            texcoords.push_back(glm::vec2(x / float(n) * 8.0f, z / float(n) * 8.0f));
+        }
+    for (int z = 0; z < n; z++)
+        for (int x = 0; x < n; x++) {
+            unsigned int a = z * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+            indices.insert(indices.end(), { a, c, d, a, d, b });
+        }
+}
+
+int main(int argc, char** argv)
+{
+    int triangles = (argc > 1) ? std::atoi(argv[1]) : 8000;
+    int frames = (argc > 2) ? std::atoi(argv[2]) : 200;
+    unsigned int maxThreads = (argc > 3) ? std::atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<uint32_t> texels;
+    for (int y = 0; y < 64; y++)
+        for (int x = 0; x < 64; x++)
+            texels.push_back(((x / 8 + y / 8) & 1) ? PackARGB(200, 160, 90, 255) : PackARGB(60, 90, 40, 255));
+    SoftwareTexture texture;
+    texture.create(64, 64, texels, SOFTWARE_TEXTURE_MORTON);
+
+    // fill convention: every pixel blended exactly once
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texcoords;
+        std::vector<unsigned int> indices;
+        makeGrid(37, 1.0f, false, positions, texcoords, indices);
+        for (glm::vec3& p : positions)
+            p = glm::vec3(p.x, p.z, 0.0f); // in the z = 0 plane, exactly covering NDC
+        SoftwareDraw draw;
+        draw.positions = positions.data();
+        draw.indices = indices.data();
+        draw.indexCount = indices.size();
+        draw.color = PackARGB(255, 255, 255, 255);
+        draw.alpha = 128;
+        draw.state = RASTER_DEPTH_TEST | RASTER_BLEND;
+
+        SoftwareRasterizer raster;
+        raster.clearColor = PackARGB(0, 0, 0, 255);
+        raster.resize(320, 240);
+        raster.render({ draw }, nullptr);
+        uint32_t once = SoftwareRasterizer::Blend(raster.clearColor, draw.color, draw.alpha);
+        size_t wrong = 0;
+        for (int y = 0; y < raster.height; y++)
+            for (int x = 0; x < raster.width; x++)
+                wrong += raster.color[size_t(y) * raster.stride + x] != once;
+        std::printf("Fill convention: %zu of %d pixels not covered exactly once\n", wrong, raster.width * raster.height);
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texcoords;
+    std::vector<unsigned int> indices;
+    int n = std::max(1, static_cast<int>(std::sqrt(triangles / 2.0)));
+    makeGrid(n, 20.0f, true, positions, texcoords, indices);
+
+    SoftwareDraw draw;
+    draw.positions = positions.data();
+    draw.texcoords = texcoords.data();
+    draw.indices = indices.data();
+    draw.indexCount = indices.size();
+    draw.texture = &texture;
+    draw.state |= RASTER_TEXTURED;
+    std::vector<SoftwareDraw> draws(1, draw);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    std::printf("%zu triangles, 320x240, %d frames\n", indices.size() / 3, frames);
+
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+        ThreadPool pool;
+        pool.start(threads);
+        SoftwareRasterizer raster;
+        raster.resize(320, 240);
+
+        double setup = 0.0, rasterMs = 0.0, worst = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) {
+            float angle = f * 0.01f;
+            glm::mat4 view = glm::lookAt(glm::vec3(std::sin(angle) * 6.0f, 1.5f, std::cos(angle) * 6.0f),
+                                         glm::vec3(0.0f), glm::vec3(0, 1, 0));
+            draws[0].mvp = projection * view;
+            raster.render(draws, threads > 1 ? &pool : nullptr);
+            setup += raster.stats.setupMs;
+            rasterMs += raster.stats.rasterMs;
+            worst = std::max(worst, raster.stats.setupMs + raster.stats.rasterMs);
+        }
+        double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%2u threads: %6.3f ms/frame (setup %6.3f, raster %6.3f, worst %6.3f), %zu tile bins\n",
+                    threads, total / frames, setup / frames, rasterMs / frames, worst, raster.stats.binned);
+    }
+    return 0;
+}
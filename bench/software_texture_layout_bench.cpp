@@ -0,0 +1,184 @@
+// Software texture layout benchmark
+//
+// usage: software_texture_layout_bench [texture size] [frames]
+// A screen filling quad at 640x480 sampling a size^2 texture (default 2048,
+// 16 MB, larger than the caches) rotated and scaled in texture space, drawn
+// single threaded with each SoftwareTextureLayout. All layouts must give the
+// same image. Reports the best raster time per layout and, on Linux where
+// perf_event_open is allowed, L1 data and last level cache misses per pixel.
+#define SDL_MAIN_HANDLED
+
+#include <GL/glew.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+// stb_image implementation (obj_loader.hpp has it in the app)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+
+#include "software_rasterizer.hpp"
+
+// Cache miss counter of this thread (L1 data reads or last level), valid() is
+// false where it cannot be opened
+struct PerfCounter {
+    int fd = -1;
+
+    void open(bool lastLevel)
+    {
+#if defined(__linux__)
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = lastLevel ? PERF_TYPE_HARDWARE : PERF_TYPE_HW_CACHE;
+        attr.config = lastLevel ? PERF_COUNT_HW_CACHE_MISSES
+                                : PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    bool valid() const { return fd >= 0; }
+
+    void start()
+    {
+#if defined(__linux__)
+        if (valid()) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t stop()
+    {
+        uint64_t count = 0;
+#if defined(__linux__)
+        if (valid()) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) != sizeof(count))
+                count = 0;
+        }
+#endif
+        return count;
+    }
+
+    ~PerfCounter()
+    {
+#if defined(__linux__)
+        if (valid())
+            close(fd);
+#endif
+    }
+};
+
+int main(int argc, char** argv)
+{
+    int size = (argc > 1) ? std::atoi(argv[1]) : 2048;
+    int frames = (argc > 2) ? std::atoi(argv[2]) : 10;
+    const int width = 640, height = 480;
+
+    std::vector<uint32_t> linear(size_t(size) * size);
+    uint32_t seed = 12345;
+    for (uint32_t& texel : linear) {
+        seed = seed * 1664525u + 1013904223u;
+        texel = seed | 0xFF000000;
+    }
+    SoftwareTexture texture;
+    texture.create(size, size, linear, SOFTWARE_TEXTURE_LINEAR);
+
+    const glm::vec3 positions[] = { { -1, -1, 0 }, { 1, -1, 0 }, { 1, 1, 0 }, { -1, 1, 0 } };
+    const unsigned int indices[] = { 0, 1, 2, 0, 2, 3 };
+    glm::vec2 texcoords[4];
+
+    SoftwareDraw draw;
+    draw.positions = positions;
+    draw.texcoords = texcoords;
+    draw.indices = indices;
+    draw.indexCount = 6;
+    draw.mvp = glm::mat4(1.0f);
+    draw.texture = &texture;
+    draw.state = RASTER_TEXTURED;
+    std::vector<SoftwareDraw> draws = { draw };
+
+    SoftwareRasterizer raster;
+    raster.resize(width, height);
+
+    PerfCounter l1Misses, llcMisses;
+    l1Misses.open(false);
+    llcMisses.open(true);
+    if (!l1Misses.valid() || !llcMisses.valid())
+        std::printf("perf_event_open not available, no cache miss counts\n");
+
+    // texels per pixel, rotation in degrees
+    const float scales[] = { 0.5f, 1.0f, 2.0f };
+    const float angles[] = { 0.0f, 30.0f, 90.0f };
+    double total[SOFTWARE_TEXTURE_LAYOUT_COUNT] = {};
+    size_t mismatches = 0;
+
+    std::printf("%dx%d texture, %dx%d quad, best of %d frames, 1 thread\n", size, size, width, height, frames);
+    std::printf("%-14s %-10s %10s %9s %12s %12s\n", "quad", "layout", "raster", "Mpix/s", "L1D miss/px",
+                "LLC miss/px");
+    for (float scale : scales)
+        for (float angle : angles) {
+            // corners of the quad in texels around the texture center
+            float c = std::cos(glm::radians(angle)), s = std::sin(glm::radians(angle));
+            for (int i = 0; i < 4; i++) {
+                float x = positions[i].x * width * 0.5f * scale, y = positions[i].y * height * 0.5f * scale;
+                texcoords[i] = glm::vec2(0.5f + (c * x - s * y) / size, 0.5f + (s * x + c * y) / size);
+            }
+
+            std::vector<uint32_t> reference;
+            for (int layout = 0; layout < SOFTWARE_TEXTURE_LAYOUT_COUNT; layout++) {
+                texture.relayout(SoftwareTextureLayout(layout));
+                double best = 1e30;
+                uint64_t l1 = 0, llc = 0;
+                for (int f = 0; f < frames; f++) {
+                    l1Misses.start();
+                    llcMisses.start();
+                    raster.render(draws, nullptr);
+                    uint64_t frameL1 = l1Misses.stop(), frameLlc = llcMisses.stop();
+                    if (raster.stats.rasterMs < best) {
+                        best = raster.stats.rasterMs;
+                        l1 = frameL1;
+                        llc = frameLlc;
+                    }
+                }
+                total[layout] += best;
+                if (layout == 0)
+                    reference = raster.color;
+                bool same = raster.color == reference;
+                mismatches += !same;
+
+                char quad[32];
+                std::snprintf(quad, sizeof(quad), "x%.1f %3.0f deg", scale, angle);
+                const double pixels = double(width) * height;
+                if (l1Misses.valid() && llcMisses.valid())
+                    std::printf("%-14s %-10s %7.3f ms %9.1f %12.3f %12.3f%s\n", quad,
+                                SoftwareTextureLayoutName(SoftwareTextureLayout(layout)), best,
+                                pixels / best / 1000.0, l1 / pixels, llc / pixels, same ? "" : "  MISMATCH");
+                else
+                    std::printf("%-14s %-10s %7.3f ms %9.1f %12s %12s%s\n", quad,
+                                SoftwareTextureLayoutName(SoftwareTextureLayout(layout)), best,
+                                pixels / best / 1000.0, "-", "-", same ? "" : "  MISMATCH");
+            }
+        }
+
+    std::printf("total:");
+    for (int layout = 0; layout < SOFTWARE_TEXTURE_LAYOUT_COUNT; layout++)
+        std::printf(" %s %.3f ms%s", SoftwareTextureLayoutName(SoftwareTextureLayout(layout)), total[layout],
+                    layout + 1 < SOFTWARE_TEXTURE_LAYOUT_COUNT ? "," : "");
+    std::printf("; %zu mismatching images\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+// Spatial index benchmark
+//
+// usage: spatial_index_bench [queries] [moved percent]
+// For 10k / 100k / 1M random boxes (constant density): build time, incremental
+// update of moving objects, frustum culling vs the flat SIMD CullFrustum and
+// sphere / ray queries vs brute force. Results are checked against brute force.
+#define SDL_MAIN_HANDLED
+
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "obj_loader.hpp"
+#include "mesh_registry.hpp"
+#include "game_objects.hpp"
+#include "frustum_culling.hpp"
+#include "spatial_index.hpp"
+
+static double Seconds(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b)
+{
+    return std::chrono::duration<double>(b - a).count();
+}
+
+static bool RunSize(size_t count, int queries, int movedPercent)
+{
+    using Clock = std::chrono::steady_clock;
+    std::mt19937 rng(1234);
+    const float world = 4.0f * std::cbrt(static_cast<float>(count)); // ~1 object per 64 units^3
+    std::uniform_real_distribution<float> pos(-world * 0.5f, world * 0.5f);
+    std::uniform_real_distribution<float> size(0.2f, 1.5f);
+    std::uniform_real_distribution<float> step(-0.05f, 0.05f); // ~3 units/s at 60 fps
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<glm::vec3> centers(count), extents(count);
+    for (size_t i = 0; i < count; i++) {
+        centers[i] = glm::vec3(pos(rng), pos(rng), pos(rng));
+        extents[i] = glm::vec3(size(rng), size(rng), size(rng));
+    }
+
+    // --- build by incremental inserts ---
+    SpatialIndex index;
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < count; i++)
+        index.update(static_cast<uint32_t>(i), centers[i] - extents[i], centers[i] + extents[i]);
+    double buildS = Seconds(t0, Clock::now());
+    t0 = Clock::now();
+    index.compact();
+    double compactS = Seconds(t0, Clock::now());
+
+    // --- one frame of movement, small steps plus a few teleports ---
+    size_t moved = count * movedPercent / 100;
+    std::uniform_int_distribution<size_t> pick(0, count - 1);
+    t0 = Clock::now();
+    for (size_t m = 0; m < moved; m++) {
+        size_t i = pick(rng);
+        centers[i] += (m % 100 == 0) ? glm::vec3(pos(rng), pos(rng), pos(rng)) - centers[i]
+                                     : glm::vec3(step(rng), step(rng), step(rng));
+        index.update(static_cast<uint32_t>(i), centers[i] - extents[i], centers[i] + extents[i]);
+    }
+    double updateS = Seconds(t0, Clock::now());
+    bool ok = index.validate();
+
+    CullingSoA soa;
+    soa.resize(count);
+    for (size_t i = 0; i < count; i++)
+        soa.set(i, centers[i], extents[i]);
+
+    // --- frustum ---
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, -1.0f), glm::vec3(0, 1, 0));
+    Frustum frustum = ExtractFrustum(projection * view);
+
+    std::vector<uint32_t> treeVisible, flatVisible;
+    double treeFrustumS = 1e30, flatFrustumS = 1e30;
+    for (int r = 0; r < 10; r++) {
+        treeVisible.clear();
+        t0 = Clock::now();
+        index.queryFrustum(frustum, treeVisible);
+        auto t1 = Clock::now();
+        CullFrustum(soa, frustum, flatVisible);
+        auto t2 = Clock::now();
+        treeFrustumS = std::min(treeFrustumS, Seconds(t0, t1));
+        flatFrustumS = std::min(flatFrustumS, Seconds(t1, t2));
+    }
+    std::sort(treeVisible.begin(), treeVisible.end());
+    ok = ok && treeVisible == flatVisible;
+
+    // --- sphere ---
+    std::vector<uint32_t> found;
+    size_t treeSphereHits = 0, bruteSphereHits = 0;
+    double treeSphereS = 0.0, bruteSphereS = 0.0;
+    for (int q = 0; q < queries; q++) {
+        glm::vec3 c(pos(rng), pos(rng), pos(rng));
+        float radius = 5.0f;
+        found.clear();
+        t0 = Clock::now();
+        index.querySphere(c, radius, found);
+        auto t1 = Clock::now();
+        size_t brute = 0;
+        for (size_t i = 0; i < count; i++)
+            brute += BoundsSphereOverlap(centers[i] - extents[i], centers[i] + extents[i], c, radius);
+        auto t2 = Clock::now();
+        treeSphereS += Seconds(t0, t1);
+        bruteSphereS += Seconds(t1, t2);
+        treeSphereHits += found.size();
+        bruteSphereHits += brute;
+    }
+    ok = ok && treeSphereHits == bruteSphereHits;
+
+    // --- ray ---
+    size_t rayMismatches = 0;
+    double treeRayS = 0.0, bruteRayS = 0.0;
+    for (int q = 0; q < queries; q++) {
+        glm::vec3 origin(pos(rng), pos(rng), pos(rng));
+        glm::vec3 dir = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(1e-3f));
+        RayHit hit;
+        t0 = Clock::now();
+        index.raycast(origin, dir, world, hit);
+        auto t1 = Clock::now();
+        float best = world, t;
+        glm::vec3 invDir = 1.0f / dir;
+        for (size_t i = 0; i < count; i++)
+            if (RayHitsBounds(origin, invDir, centers[i] - extents[i], centers[i] + extents[i], best, t))
+                best = t;
+        auto t2 = Clock::now();
+        treeRayS += Seconds(t0, t1);
+        bruteRayS += Seconds(t1, t2);
+        float treeBest = (hit.object != UINT32_MAX) ? hit.distance : world;
+        rayMismatches += treeBest != best;
+    }
+    ok = ok && rayMismatches == 0;
+
+    std::printf("%zu objects, tree height %d, %s\n", count, index.height(), ok ? "results match" : "MISMATCH");
+    std::printf("  build:   %9.2f ms, compact %.2f ms\n", buildS * 1e3, compactS * 1e3);
+    std::printf("  update:  %9.2f ms for %zu moved (%zu reinserted)\n", updateS * 1e3, moved, index.reinserts);
+    std::printf("  frustum: %9.3f ms tree, %9.3f ms flat SIMD (%zu visible)\n",
+                treeFrustumS * 1e3, flatFrustumS * 1e3, flatVisible.size());
+    std::printf("  sphere:  %9.4f ms tree, %9.4f ms brute per query\n",
+                treeSphereS * 1e3 / queries, bruteSphereS * 1e3 / queries);
+    std::printf("  ray:     %9.4f ms tree, %9.4f ms brute per query\n",
+                treeRayS * 1e3 / queries, bruteRayS * 1e3 / queries);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int queries = (argc > 1) ? std::atoi(argv[1]) : 100;
+    int movedPercent = (argc > 2) ? std::atoi(argv[2]) : 10;
+
+    bool ok = true;
+    for (size_t count : { size_t(10000), size_t(100000), size_t(1000000) })
+        ok = RunSize(count, queries, movedPercent) && ok;
+    return ok ? 0 : 1;
+}
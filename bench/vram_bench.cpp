@@ -0,0 +1,151 @@
+// Emulated VRAM benchmark
+//
+// usage: vram_bench [working set] [frames]
+// Budget: random sized textures (16..256 texels a side, 4 bit) are loaded
+// into an empty VRAM (display area reserved) with VRAM_FAIL until one no
+// longer fits, then with VRAM_EVICT a random working set of them (default
+// 48) is drawn per frame and the uploads / evictions are counted.
+// Sampling: a rotated textured quad at 320x240 from a 256x256 texture at
+// each VRAM depth; the image must equal the one drawn from a memory texture
+// decoded from the pool's main memory copy (placement and CLUT addressing).
+#define SDL_MAIN_HANDLED
+
+#include <GL/glew.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+// stb_image implementation (obj_loader.hpp has it in the app)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+
+#include "software_rasterizer.hpp"
+
+static std::vector<uint8_t> makeImage(int width, int height, uint32_t seed)
+{
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) {
+            uint8_t* p = &rgba[(size_t(y) * width + x) * 4];
+            p[0] = uint8_t(x * 255 / width);
+            p[1] = uint8_t(y * 255 / height);
+            p[2] = uint8_t(((x / 8 + y / 8) & 1) * 200 + seed % 55);
+            p[3] = 255;
+        }
+    return rgba;
+}
+
+// ARGB texels of an entry from its main memory words, independent of VRAM
+static std::vector<uint32_t> decodeEntry(const VramTexturePool::Entry& entry)
+{
+    const int texelsPerWord = VramTexelsPerWord(entry.depth), bits = 16 / texelsPerWord;
+    std::vector<uint32_t> texels;
+    for (int y = 0; y < entry.height; y++)
+        for (int x = 0; x < entry.width; x++) {
+            uint16_t word = entry.words[size_t(y) * entry.wordWidth + x / texelsPerWord];
+            uint16_t index = (word >> (x % texelsPerWord * bits)) & ((1 << bits) - 1);
+            texels.push_back(VramColorARGB(entry.clut.empty() ? word : entry.clut[index]));
+        }
+    return texels;
+}
+
+int main(int argc, char** argv)
+{
+    int workingSet = (argc > 1) ? std::atoi(argv[1]) : 48;
+    int frames = (argc > 2) ? std::atoi(argv[2]) : 600;
+    std::mt19937 random(1234);
+
+    // budget: fill until the first failure, then stream a working set
+    {
+        VramTexturePool pool;
+        pool.reserve(VRAM_DISPLAY_AREA);
+        pool.overflow = VRAM_FAIL;
+        std::vector<int32_t> textures;
+        std::uniform_int_distribution<int> sizeBits(4, 8);
+        for (int i = 0;; i++) {
+            int width = 1 << sizeBits(random), height = 1 << sizeBits(random);
+            std::vector<uint8_t> rgba = makeImage(width, height, i);
+            int32_t index = pool.acquireImage("texture" + std::to_string(i), rgba.data(), width, height);
+            if (!pool.entries[index].resident) {
+                std::printf("VRAM_FAIL: %zu textures loaded before %dx%d did not fit\n", textures.size(), width, height);
+                pool.release(index);
+                break;
+            }
+            textures.push_back(index);
+        }
+        pool.printStats();
+
+        pool.overflow = VRAM_EVICT;
+        const int loaded = int(textures.size());
+        for (int i = 0; i < loaded; i++) {
+            int width = 1 << sizeBits(random), height = 1 << sizeBits(random);
+            std::vector<uint8_t> rgba = makeImage(width, height, i);
+            textures.push_back(pool.acquireImage("extra" + std::to_string(i), rgba.data(), width, height));
+        }
+        size_t uploadsBefore = pool.stats.uploads, evictionsBefore = pool.stats.evictions;
+        std::uniform_int_distribution<size_t> pick(0, textures.size() - 1);
+        std::vector<int32_t> set(workingSet);
+        for (int f = 0; f < frames; f++) {
+            // the working set drifts: a few textures change per frame
+            if (f == 0)
+                for (int32_t& t : set)
+                    t = textures[pick(random)];
+            for (int k = 0; k < 2; k++)
+                set[random() % set.size()] = textures[pick(random)];
+            pool.beginFrame();
+            for (int32_t t : set)
+                pool.use(t);
+        }
+        std::printf("VRAM_EVICT: %zu textures, working set %d, %d frames: %.2f uploads and %.2f evictions per frame\n",
+                    textures.size(), workingSet, frames, double(pool.stats.uploads - uploadsBefore) / frames,
+                    double(pool.stats.evictions - evictionsBefore) / frames);
+        pool.printStats();
+    }
+
+    // sampling: VRAM against memory textures with the same texels
+    {
+        const glm::vec3 positions[] = { { -0.8f, -0.9f, 0 }, { 0.9f, -0.7f, 0 }, { 0.7f, 0.9f, 0 }, { -0.9f, 0.8f, 0 } };
+        const glm::vec2 texcoords[] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+        const unsigned int indices[] = { 0, 1, 2, 0, 2, 3 };
+        SoftwareDraw draw;
+        draw.positions = positions;
+        draw.texcoords = texcoords;
+        draw.indices = indices;
+        draw.indexCount = 6;
+
+        SoftwareRasterizer raster;
+        raster.resize(320, 240);
+        const char* depthNames[] = { "4 bit CLUT", "8 bit CLUT", "15 bit" };
+        std::vector<uint8_t> rgba = makeImage(256, 256, 7);
+        size_t mismatches = 0;
+        for (int depth = VRAM_4BIT; depth <= VRAM_15BIT; depth++) {
+            VramTexturePool pool;
+            pool.depth = VramDepth(depth);
+            int32_t index = pool.acquireImage("quad", rgba.data(), 256, 256);
+            SoftwareTexture reference;
+            reference.create(256, 256, decodeEntry(pool.entries[index]), SOFTWARE_TEXTURE_TILED_8X8);
+
+            double best[2] = { 1e30, 1e30 };
+            std::vector<uint32_t> images[2];
+            for (int vram = 0; vram < 2; vram++) {
+                draw.texture = vram ? nullptr : &reference;
+                draw.vramTexture = vram ? pool.use(index) : nullptr;
+                draw.state = RASTER_TEXTURED | (vram ? uint32_t(RASTER_VRAM) : 0u);
+                for (int f = 0; f < 50; f++) {
+                    raster.render({ draw }, nullptr);
+                    best[vram] = std::min(best[vram], raster.stats.rasterMs);
+                }
+                images[vram] = raster.color;
+            }
+            bool same = images[0] == images[1];
+            mismatches += !same;
+            std::printf("%-10s: memory texture %.3f ms, VRAM %.3f ms%s\n", depthNames[depth], best[0], best[1],
+                        same ? "" : "  MISMATCH");
+        }
+        std::printf("%zu mismatching images\n", mismatches);
+        return mismatches == 0 ? 0 : 1;
+    }
+}
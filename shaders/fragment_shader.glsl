@@ -2,9 +2,24 @@
 in vec2 TexCoord;
 out vec4 FragColor;
 
-uniform sampler2D diffuseTex;
+uniform sampler2DArray diffuseTex; // TexturePool array
+uniform float Alpha; // Material::d
+uniform float Layer; // layer of the material's texture
+uniform vec4 AtlasRect; // atlas entry to tile wrapping uvs in, z = 0: uvs used as they are
+uniform sampler2D clutTex; // TexturePool palettes, one row per texture
+uniform float Clut; // palette row, < 0: diffuseTex holds colors, not indices
 
 void main()
 {
-    FragColor = texture(diffuseTex, TexCoord);
+    vec4 color;
+    if (AtlasRect.z > 0.0) {
+        // gradients of the unwrapped uv, fract() would jump to the smallest mip at the seams
+        vec2 uv = AtlasRect.xy + fract(TexCoord) * AtlasRect.zw;
+        color = textureGrad(diffuseTex, vec3(uv, Layer), dFdx(TexCoord) * AtlasRect.zw, dFdy(TexCoord) * AtlasRect.zw);
+    } else {
+        color = texture(diffuseTex, vec3(TexCoord, Layer));
+    }
+    if (Clut >= 0.0)
+        color = texelFetch(clutTex, ivec2(int(color.r * 255.0 + 0.5), int(Clut)), 0);
+    FragColor = color * vec4(1.0, 1.0, 1.0, Alpha);
 }
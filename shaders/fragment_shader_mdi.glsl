@@ -0,0 +1,24 @@
+// #version is prepended by MultiDrawRenderer
+in vec2 TexCoord;
+flat in float DrawAlpha; // Material::d per draw
+flat in float DrawLayer; // texture array layer per draw
+flat in vec4 DrawAtlasRect; // atlas entry to tile wrapping uvs in, z = 0: none
+flat in float DrawClut; // palette row, < 0: not palettized
+out vec4 FragColor;
+
+uniform sampler2DArray diffuseTex; // TexturePool array
+uniform sampler2D clutTex; // TexturePool palettes
+
+void main()
+{
+    vec4 color;
+    if (DrawAtlasRect.z > 0.0) {
+        vec2 uv = DrawAtlasRect.xy + fract(TexCoord) * DrawAtlasRect.zw;
+        color = textureGrad(diffuseTex, vec3(uv, DrawLayer), dFdx(TexCoord) * DrawAtlasRect.zw, dFdy(TexCoord) * DrawAtlasRect.zw);
+    } else {
+        color = texture(diffuseTex, vec3(TexCoord, DrawLayer));
+    }
+    if (DrawClut >= 0.0)
+        color = texelFetch(clutTex, ivec2(int(color.r * 255.0 + 0.5), int(DrawClut)), 0);
+    FragColor = color * vec4(1.0, 1.0, 1.0, DrawAlpha);
+}
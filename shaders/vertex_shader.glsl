@@ -2,12 +2,19 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec2 aTexCoord;
 
-uniform mat4 MVP;
+layout(std140) uniform FrameData {
+    mat4 View;
+    mat4 Projection;
+    mat4 ViewProjection;
+    vec4 CameraPos;
+};
+
+uniform mat4 Model;
 
 out vec2 TexCoord;
 
 void main()
 {
-    gl_Position = MVP * vec4(aPos, 1.0);
+    gl_Position = ViewProjection * Model * vec4(aPos, 1.0);
     TexCoord = aTexCoord;
 }
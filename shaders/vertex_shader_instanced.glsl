@@ -0,0 +1,19 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTexCoord;
+layout(location = 3) in mat4 aModel; // per instance, locations 3-6
+
+layout(std140) uniform FrameData {
+    mat4 View;
+    mat4 Projection;
+    mat4 ViewProjection;
+    vec4 CameraPos;
+};
+
+out vec2 TexCoord;
+
+void main()
+{
+    gl_Position = ViewProjection * aModel * vec4(aPos, 1.0);
+    TexCoord = aTexCoord;
+}
@@ -0,0 +1,52 @@
+// #version is prepended by MultiDrawRenderer (430 + DRAW_DATA_SSBO or 330)
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTexCoord;
+layout(location = 8) in uint aDrawIndex; // baseInstance of the command
+
+layout(std140) uniform FrameData {
+    mat4 View;
+    mat4 Projection;
+    mat4 ViewProjection;
+    vec4 CameraPos;
+};
+
+#ifdef DRAW_DATA_SSBO
+struct DrawData {
+    mat4 model;
+    vec4 params; // x: alpha, y: texture layer, z: CLUT row
+    vec4 atlasRect; // TextureAtlas entry for tiled uvs
+};
+layout(std430, binding = 1) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+mat4 drawModel(uint i) { return draws[i].model; }
+vec4 drawParams(uint i) { return draws[i].params; }
+vec4 drawAtlasRect(uint i) { return draws[i].atlasRect; }
+#else
+uniform samplerBuffer drawDataTex; // 6 texels per draw: model columns, params, atlasRect
+mat4 drawModel(uint i)
+{
+    int base = int(i) * 6;
+    return mat4(texelFetch(drawDataTex, base), texelFetch(drawDataTex, base + 1),
+                texelFetch(drawDataTex, base + 2), texelFetch(drawDataTex, base + 3));
+}
+vec4 drawParams(uint i) { return texelFetch(drawDataTex, int(i) * 6 + 4); }
+vec4 drawAtlasRect(uint i) { return texelFetch(drawDataTex, int(i) * 6 + 5); }
+#endif
+
+out vec2 TexCoord;
+flat out float DrawAlpha;
+flat out float DrawLayer;
+flat out vec4 DrawAtlasRect;
+flat out float DrawClut;
+
+void main()
+{
+    gl_Position = ViewProjection * drawModel(aDrawIndex) * vec4(aPos, 1.0);
+    TexCoord = aTexCoord;
+    vec4 params = drawParams(aDrawIndex);
+    DrawAlpha = params.x;
+    DrawLayer = params.y;
+    DrawClut = params.z;
+    DrawAtlasRect = drawAtlasRect(aDrawIndex);
+}
@@ -0,0 +1,174 @@
+// Dynamic resolution scaling
+//
+// GPU time of the scene is measured with GL_TIME_ELAPSED queries, read a few
+// frames later so the CPU never waits on them. The controller smooths the
+// frame time and steps the render scale down when it gets close to the budget
+// and back up only when the next larger step is predicted (time ~ pixel count)
+// to fit with a margin, after a settle period: the gap between the two
+// thresholds keeps it from oscillating between neighbouring steps.
+//
+// The render target is allocated once at the full internal resolution, a step
+// only changes the viewport rendered into and the rectangle blitted from, so
+// changes never reallocate anything mid frame.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+// Render scales (per axis) from full internal resolution down
+const float DYNAMIC_RESOLUTION_STEPS[] = { 1.0f, 0.875f, 0.75f, 0.625f, 0.5f };
+const int DYNAMIC_RESOLUTION_STEP_COUNT = sizeof(DYNAMIC_RESOLUTION_STEPS) / sizeof(DYNAMIC_RESOLUTION_STEPS[0]);
+
+// Ring of timer queries around the scene, results come back GPU_TIMER_LATENCY frames late
+const int GPU_TIMER_LATENCY = 4;
+
+struct GpuFrameTimer {
+    GLuint queries[GPU_TIMER_LATENCY] = {};
+    bool pending[GPU_TIMER_LATENCY] = {};
+    int current = 0;
+    bool active = false;
+
+    void create()
+    {
+        glGenQueries(GPU_TIMER_LATENCY, queries);
+    }
+
+    void destroy()
+    {
+        if (queries[0])
+            glDeleteQueries(GPU_TIMER_LATENCY, queries);
+        std::fill(queries, queries + GPU_TIMER_LATENCY, 0);
+        std::fill(pending, pending + GPU_TIMER_LATENCY, false);
+    }
+
+    // Start timing this frame, skipped while the slot's previous result is still in flight
+    void begin()
+    {
+        active = queries[0] && !pending[current];
+        if (active)
+            glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void end()
+    {
+        if (active) {
+            glEndQuery(GL_TIME_ELAPSED);
+            pending[current] = true;
+        }
+        current = (current + 1) % GPU_TIMER_LATENCY;
+    }
+
+    // Newest finished result in ms (older finished ones are dropped), false if
+    // none is available yet
+    bool poll(double& ms)
+    {
+        bool found = false;
+        for (int i = 0; i < GPU_TIMER_LATENCY; i++) {
+            int slot = (current + i) % GPU_TIMER_LATENCY;
+            if (!pending[slot])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break; // later slots finish later
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &ns);
+            pending[slot] = false;
+            ms = ns / 1.0e6;
+            found = true;
+        }
+        return found;
+    }
+};
+
+struct DynamicResolutionStats {
+    double gpuMs = 0.0, cpuMs = 0.0, smoothedMs = 0.0;
+    size_t stepsDown = 0, stepsUp = 0;
+};
+
+struct DynamicResolution {
+    bool enabled = true;
+    double budgetMs = 1000.0 / 60.0;
+    double downThreshold = 0.95; // of the budget, step down above
+    double upThreshold = 0.80;   // of the budget, step up if the larger step is predicted below
+    double smoothing = 0.1;      // weight of a new sample
+    int downFrames = 4;          // consecutive samples over before stepping down
+    int upFrames = 60;           // consecutive samples under before stepping up
+    int settleFrames = 2 * GPU_TIMER_LATENCY; // samples ignored after a change
+
+    int step = 0;
+    int over = 0, under = 0, settle = 0;
+    bool hasGpuTime = false;
+    DynamicResolutionStats stats;
+
+    float scale() const { return enabled ? DYNAMIC_RESOLUTION_STEPS[step] : 1.0f; }
+
+    void reset()
+    {
+        step = 0;
+        over = under = 0;
+        settle = settleFrames;
+        stats.smoothedMs = 0.0;
+    }
+
+    // Feed one frame: gpuMs < 0 if no timer result arrived this frame. Until
+    // the first result the CPU frame time drives the controller, after that only
+    // frames with a new result are smoothed and counted. Returns true if the
+    // scale changed.
+    bool update(double gpuMs, double cpuMs)
+    {
+        stats.cpuMs = cpuMs;
+        if (gpuMs >= 0.0) {
+            stats.gpuMs = gpuMs;
+            hasGpuTime = true;
+        }
+        if (!enabled || (hasGpuTime && gpuMs < 0.0))
+            return false;
+        if (settle > 0) {
+            settle--;
+            return false;
+        }
+
+        // with timer queries only the GPU cost scales with resolution
+        double ms = hasGpuTime ? gpuMs : cpuMs;
+        stats.smoothedMs = stats.smoothedMs == 0.0 ? ms : stats.smoothedMs + (ms - stats.smoothedMs) * smoothing;
+
+        over = stats.smoothedMs > budgetMs * downThreshold ? over + 1 : 0;
+        if (step + 1 < DYNAMIC_RESOLUTION_STEP_COUNT && over >= downFrames)
+            return changeStep(step + 1);
+
+        if (step > 0) {
+            float ratio = DYNAMIC_RESOLUTION_STEPS[step - 1] / DYNAMIC_RESOLUTION_STEPS[step];
+            double predicted = stats.smoothedMs * ratio * ratio;
+            under = predicted < budgetMs * upThreshold ? under + 1 : 0;
+            if (under >= upFrames)
+                return changeStep(step - 1);
+        }
+        return false;
+    }
+
+    bool changeStep(int newStep)
+    {
+        if (newStep > step)
+            stats.stepsDown++;
+        else
+            stats.stepsUp++;
+        // the smoothed time is rescaled instead of restarting from the next (stale) sample
+        float ratio = DYNAMIC_RESOLUTION_STEPS[newStep] / DYNAMIC_RESOLUTION_STEPS[step];
+        stats.smoothedMs *= ratio * ratio;
+        step = newStep;
+        over = under = 0;
+        settle = settleFrames;
+        return true;
+    }
+
+    void print() const
+    {
+        std::cout << "Dynamic resolution: " << (enabled ? "on" : "off") << ", scale " << scale()
+                  << ", budget " << budgetMs << " ms, GPU " << stats.gpuMs << " ms"
+                  << (hasGpuTime ? "" : " (no timer queries)") << ", CPU " << stats.cpuMs
+                  << " ms, smoothed " << stats.smoothedMs << " ms, " << stats.stepsDown << " steps down, "
+                  << stats.stepsUp << " up\n";
+    }
+};
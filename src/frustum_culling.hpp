@@ -0,0 +1,224 @@
+// Frustum culling over structure-of-arrays bounds
+//
+// World space AABBs of all scene objects are kept as center / extent arrays
+// (one entry per scene object, refreshed only for objects whose boundsDirty is
+// set). CullFrustum tests 8 (AVX2) or 4 (SSE) boxes at a time against the six
+// planes of Projection * View and returns the indices of the survivors.
+//
+// The frame path culls with the BVH (SpatialIndex::queryFrustum), which runs
+// the same BatchOutsideFrustum kernel on its leaves; the flat CullingSoA scan
+// is kept as its baseline in bench/spatial_index_bench.cpp.
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+const int FRUSTUM_BATCH = 8;
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define FRUSTUM_CULL_SSE 1
+const int FRUSTUM_BATCH = 4;
+#else
+const int FRUSTUM_BATCH = 4; // scalar loop
+#endif
+
+// Planes as (normal, d), inside where dot(normal, p) + d >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Gribb / Hartmann plane extraction from a GL clip matrix
+Frustum ExtractFrustum(const glm::mat4& viewProjection)
+{
+    const glm::mat4& m = viewProjection;
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum f;
+    f.planes[0] = row3 + row0; // left
+    f.planes[1] = row3 - row0; // right
+    f.planes[2] = row3 + row1; // bottom
+    f.planes[3] = row3 - row1; // top
+    f.planes[4] = row3 + row2; // near
+    f.planes[5] = row3 - row2; // far
+
+    for (glm::vec4& p : f.planes)
+        p /= glm::length(glm::vec3(p));
+    return f;
+}
+
+// World space AABB per scene object, as center / half extent
+struct CullingSoA {
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    size_t size() const { return centerX.size(); }
+
+    void resize(size_t n)
+    {
+        centerX.resize(n); centerY.resize(n); centerZ.resize(n);
+        extentX.resize(n); extentY.resize(n); extentZ.resize(n);
+    }
+
+    void set(size_t i, const glm::vec3& center, const glm::vec3& extent)
+    {
+        centerX[i] = center.x; centerY[i] = center.y; centerZ[i] = center.z;
+        extentX[i] = extent.x; extentY[i] = extent.y; extentZ[i] = extent.z;
+    }
+};
+
+// Transform an object space AABB by model, result as world center / extent
+void TransformBounds(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                     glm::vec3& center, glm::vec3& extent)
+{
+    glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 localExtent = (boundsMax - boundsMin) * 0.5f;
+
+    center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+    glm::mat3 absModel(model);
+    for (int c = 0; c < 3; c++)
+        absModel[c] = glm::abs(absModel[c]);
+    extent = absModel * localExtent;
+}
+
+// Refresh the world bounds of new or moved objects (boundsDirty)
+void SyncWorldBounds(std::vector<GameObject>& objects, const MeshRegistry& registry, CullingSoA& soa)
+{
+    size_t oldSize = soa.size();
+    soa.resize(objects.size());
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        GameObject& obj = objects[i];
+        if (!obj.boundsDirty && i < oldSize)
+            continue;
+
+        glm::vec3 center(0.0f), extent(0.0f);
+        if (obj.mesh.valid()) {
+            const GpuMesh& gpu = registry.get(obj.mesh);
+            TransformBounds(obj.model, gpu.boundsMin, gpu.boundsMax, center, extent);
+        }
+        soa.set(i, center, extent);
+        obj.boundsDirty = false;
+    }
+}
+
+// Scalar test of one box, true if outside any plane
+inline bool BoxOutsideFrustum(const Frustum& f, float cx, float cy, float cz, float ex, float ey, float ez)
+{
+    for (const glm::vec4& p : f.planes) {
+        float d = p.x * cx + p.y * cy + p.z * cz + p.w
+                + std::fabs(p.x) * ex + std::fabs(p.y) * ey + std::fabs(p.z) * ez;
+        if (d < 0.0f)
+            return true;
+    }
+    return false;
+}
+
+// The six planes broadcast for BatchOutsideFrustum, set up once per frustum
+struct FrustumBatchPlanes {
+#if defined(__AVX2__)
+    __m256 n[6][3], a[6][3], d[6]; // normal, |normal|, distance
+#elif defined(FRUSTUM_CULL_SSE)
+    __m128 n[6][3], a[6][3], d[6];
+#else
+    Frustum f;
+#endif
+
+    explicit FrustumBatchPlanes(const Frustum& frustum)
+    {
+#if defined(__AVX2__)
+        for (int k = 0; k < 6; k++) {
+            for (int c = 0; c < 3; c++) {
+                n[k][c] = _mm256_set1_ps(frustum.planes[k][c]);
+                a[k][c] = _mm256_set1_ps(std::fabs(frustum.planes[k][c]));
+            }
+            d[k] = _mm256_set1_ps(frustum.planes[k].w);
+        }
+#elif defined(FRUSTUM_CULL_SSE)
+        for (int k = 0; k < 6; k++) {
+            for (int c = 0; c < 3; c++) {
+                n[k][c] = _mm_set1_ps(frustum.planes[k][c]);
+                a[k][c] = _mm_set1_ps(std::fabs(frustum.planes[k][c]));
+            }
+            d[k] = _mm_set1_ps(frustum.planes[k].w);
+        }
+#else
+        f = frustum;
+#endif
+    }
+};
+
+// FRUSTUM_BATCH boxes starting at the given center / extent pointers, bit i
+// set if box i is outside one of the planes
+inline unsigned int BatchOutsideFrustum(const FrustumBatchPlanes& p, const float* centerX, const float* centerY,
+                                        const float* centerZ, const float* extentX, const float* extentY,
+                                        const float* extentZ)
+{
+#if defined(__AVX2__)
+    __m256 cx = _mm256_loadu_ps(centerX), cy = _mm256_loadu_ps(centerY), cz = _mm256_loadu_ps(centerZ);
+    __m256 ex = _mm256_loadu_ps(extentX), ey = _mm256_loadu_ps(extentY), ez = _mm256_loadu_ps(extentZ);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 outside = _mm256_setzero_ps();
+    for (int k = 0; k < 6; k++) {
+        __m256 d = _mm256_add_ps(_mm256_mul_ps(p.n[k][0], cx), p.d[k]);
+        d = _mm256_add_ps(d, _mm256_mul_ps(p.n[k][1], cy));
+        d = _mm256_add_ps(d, _mm256_mul_ps(p.n[k][2], cz));
+        d = _mm256_add_ps(d, _mm256_mul_ps(p.a[k][0], ex));
+        d = _mm256_add_ps(d, _mm256_mul_ps(p.a[k][1], ey));
+        d = _mm256_add_ps(d, _mm256_mul_ps(p.a[k][2], ez));
+        outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+    }
+    return static_cast<unsigned int>(_mm256_movemask_ps(outside));
+#elif defined(FRUSTUM_CULL_SSE)
+    __m128 cx = _mm_loadu_ps(centerX), cy = _mm_loadu_ps(centerY), cz = _mm_loadu_ps(centerZ);
+    __m128 ex = _mm_loadu_ps(extentX), ey = _mm_loadu_ps(extentY), ez = _mm_loadu_ps(extentZ);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 outside = _mm_setzero_ps();
+    for (int k = 0; k < 6; k++) {
+        __m128 d = _mm_add_ps(_mm_mul_ps(p.n[k][0], cx), p.d[k]);
+        d = _mm_add_ps(d, _mm_mul_ps(p.n[k][1], cy));
+        d = _mm_add_ps(d, _mm_mul_ps(p.n[k][2], cz));
+        d = _mm_add_ps(d, _mm_mul_ps(p.a[k][0], ex));
+        d = _mm_add_ps(d, _mm_mul_ps(p.a[k][1], ey));
+        d = _mm_add_ps(d, _mm_mul_ps(p.a[k][2], ez));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(d, zero));
+    }
+    return static_cast<unsigned int>(_mm_movemask_ps(outside));
+#else
+    unsigned int outside = 0;
+    for (int i = 0; i < FRUSTUM_BATCH; i++)
+        if (BoxOutsideFrustum(p.f, centerX[i], centerY[i], centerZ[i], extentX[i], extentY[i], extentZ[i]))
+            outside |= 1u << i;
+    return outside;
+#endif
+}
+
+// Appends the indices of all boxes intersecting the frustum to visible
+void CullFrustum(const CullingSoA& soa, const Frustum& f, std::vector<uint32_t>& visible)
+{
+    visible.clear();
+    const size_t n = soa.size();
+    const FrustumBatchPlanes planes(f);
+    size_t i = 0;
+
+    for (; i + FRUSTUM_BATCH <= n; i += FRUSTUM_BATCH) {
+        unsigned int inside = ~BatchOutsideFrustum(planes, &soa.centerX[i], &soa.centerY[i], &soa.centerZ[i],
+                                                   &soa.extentX[i], &soa.extentY[i], &soa.extentZ[i]) &
+                              ((1u << FRUSTUM_BATCH) - 1);
+        for (int lane = 0; lane < FRUSTUM_BATCH; lane++)
+            if (inside & (1u << lane))
+                visible.push_back(static_cast<uint32_t>(i + lane));
+    }
+
+    // remainder
+    for (; i < n; i++)
+        if (!BoxOutsideFrustum(f, soa.centerX[i], soa.centerY[i], soa.centerZ[i],
+                               soa.extentX[i], soa.extentY[i], soa.extentZ[i]))
+            visible.push_back(static_cast<uint32_t>(i));
+}
@@ -6,47 +6,31 @@
 
 struct GameObject {
     glm::vec3 position = glm::vec3(0.0f);
+    glm::mat4 model = glm::mat4(1.0f); // model matrix
     
-    Mesh mesh;
+    MeshHandle mesh; // shared GPU mesh, see MeshRegistry
     bool visible = true;
+    bool boundsDirty = true; // world bounds need a refresh (culling)
+    bool occluder = false;   // rasterized into the occlusion buffer, never occlusion tested
     
-    // add changepos here or in render loop
-    
-    void addMesh(Mesh mesh) {
+    void addMesh(MeshRegistry& registry, MeshHandle mesh) {
         
-        this->mesh = mesh;
+        this->mesh = registry.acquire(mesh);
         
         // set pos argument frm lvl file
-        this->mesh.model = glm::translate(glm::mat4(1.0f), this->position);
+        this->model = glm::translate(glm::mat4(1.0f), this->position);
+        this->boundsDirty = true;
     }
-        
-    void sendMesh() {
-        // Create VAO and VBO for mesh
-        glGenVertexArrays(1, &this->mesh.VAO);
-        glGenBuffers(1, &this->mesh.VBO_positions);
-        glGenBuffers(1, &this->mesh.VBO_texcoords);
-
-        glBindVertexArray(this->mesh.VAO);
-
-        // --- Positions --- 
-        glBindBuffer(GL_ARRAY_BUFFER, this->mesh.VBO_positions);
-        glBufferData(GL_ARRAY_BUFFER,
-                     this->mesh.positions.size() * sizeof(glm::vec3),
-                     this->mesh.positions.data(),
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-        glEnableVertexAttribArray(0);
-
-        // --- Texture coordinates ---
-        glBindBuffer(GL_ARRAY_BUFFER, this->mesh.VBO_texcoords);
-        glBufferData(GL_ARRAY_BUFFER,
-                     this->mesh.texcoords.size() * sizeof(glm::vec2),
-                     this->mesh.texcoords.data(),
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-        glEnableVertexAttribArray(1);
+    
+    // move the object, use this instead of writing position directly
+    void setPosition(const glm::vec3& position) {
+        this->position = position;
+        this->model = glm::translate(glm::mat4(1.0f), this->position);
+        this->boundsDirty = true;
+    }
+    
+    void removeMesh(MeshRegistry& registry) {
+        registry.release(this->mesh);
     }
-        
-        
 
-};
\ No newline at end of file
+};
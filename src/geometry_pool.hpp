@@ -0,0 +1,202 @@
+// Shared vertex / index buffers for all static meshes
+//
+// Every mesh gets a range of one big vertex buffer and one big index buffer
+// (offset allocator, first fit with coalescing), all in the same VertexFormat,
+// so a single VAO can draw any of them with baseVertex / firstIndex. Buffers
+// grow by doubling with glCopyBufferSubData when an allocation does not fit.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <vector>
+
+#include "vertex_format.hpp"
+
+const uint32_t POOL_INVALID_OFFSET = UINT32_MAX;
+
+// Free ranges of [0, capacity) in arbitrary units
+struct OffsetAllocator {
+    std::map<uint32_t, uint32_t> freeBlocks; // offset -> size
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+
+    void reset(uint32_t size)
+    {
+        freeBlocks.clear();
+        capacity = size;
+        used = 0;
+        if (size > 0)
+            freeBlocks[0] = size;
+    }
+
+    // POOL_INVALID_OFFSET if no free range is large enough
+    uint32_t allocate(uint32_t size)
+    {
+        for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+            if (it->second < size)
+                continue;
+            uint32_t offset = it->first;
+            uint32_t remaining = it->second - size;
+            freeBlocks.erase(it);
+            if (remaining > 0)
+                freeBlocks[offset + size] = remaining;
+            used += size;
+            return offset;
+        }
+        return POOL_INVALID_OFFSET;
+    }
+
+    void free(uint32_t offset, uint32_t size)
+    {
+        if (size == 0)
+            return;
+        used -= size;
+        auto next = freeBlocks.lower_bound(offset);
+
+        // merge with the following block
+        if (next != freeBlocks.end() && offset + size == next->first) {
+            size += next->second;
+            next = freeBlocks.erase(next);
+        }
+        // merge with the preceding block
+        if (next != freeBlocks.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset) {
+                prev->second += size;
+                return;
+            }
+        }
+        freeBlocks[offset] = size;
+    }
+
+    // Extend to newCapacity, the new space joins a free block at the end
+    void grow(uint32_t newCapacity)
+    {
+        uint32_t oldCapacity = capacity;
+        capacity = newCapacity;
+        used += newCapacity - oldCapacity; // free() subtracts it again
+        free(oldCapacity, newCapacity - oldCapacity);
+    }
+};
+
+// Where a mesh lives in the pool
+struct GeometryRange {
+    uint32_t baseVertex = POOL_INVALID_OFFSET;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = POOL_INVALID_OFFSET;
+    uint32_t indexCount = 0;
+
+    bool valid() const { return baseVertex != POOL_INVALID_OFFSET; }
+};
+
+struct GeometryPool {
+    GLuint VAO = 0, vertexBuffer = 0, indexBuffer = 0;
+    VertexFormat format;
+    OffsetAllocator vertices; // in vertices
+    OffsetAllocator indices;  // in indices
+
+    void create(const VertexFormat& format, uint32_t vertexCapacity, uint32_t indexCapacity)
+    {
+        this->format = format;
+        vertices.reset(vertexCapacity);
+        indices.reset(indexCapacity);
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &indexBuffer);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexCapacity) * format.stride, nullptr, GL_STATIC_DRAW);
+        ApplyVertexFormat(format);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indexCapacity) * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+    }
+
+    void destroy()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &vertexBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+        VAO = vertexBuffer = indexBuffer = 0;
+    }
+
+    // Copy buffer into a new one of newBytes, returns the new buffer
+    static GLuint GrowBuffer(GLuint buffer, GLsizeiptr oldBytes, GLsizeiptr newBytes)
+    {
+        GLuint grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+        glDeleteBuffers(1, &buffer);
+        return grown;
+    }
+
+    void growVertices(uint32_t required)
+    {
+        uint32_t capacity = std::max(vertices.capacity * 2, vertices.capacity + required);
+        vertexBuffer = GrowBuffer(vertexBuffer, static_cast<GLsizeiptr>(vertices.capacity) * format.stride,
+                                  static_cast<GLsizeiptr>(capacity) * format.stride);
+        vertices.grow(capacity);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        ApplyVertexFormat(format);
+        glBindVertexArray(0);
+    }
+
+    void growIndices(uint32_t required)
+    {
+        uint32_t capacity = std::max(indices.capacity * 2, indices.capacity + required);
+        indexBuffer = GrowBuffer(indexBuffer, static_cast<GLsizeiptr>(indices.capacity) * sizeof(unsigned int),
+                                 static_cast<GLsizeiptr>(capacity) * sizeof(unsigned int));
+        indices.grow(capacity);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBindVertexArray(0);
+    }
+
+    // Upload packed vertices (in format) and mesh relative indices
+    GeometryRange add(const std::vector<uint8_t>& packedVertices, const std::vector<unsigned int>& meshIndices)
+    {
+        GeometryRange range;
+        range.vertexCount = static_cast<uint32_t>(packedVertices.size() / format.stride);
+        range.indexCount = static_cast<uint32_t>(meshIndices.size());
+
+        range.baseVertex = vertices.allocate(range.vertexCount);
+        if (range.baseVertex == POOL_INVALID_OFFSET) {
+            growVertices(range.vertexCount);
+            range.baseVertex = vertices.allocate(range.vertexCount);
+        }
+        range.firstIndex = indices.allocate(range.indexCount);
+        if (range.firstIndex == POOL_INVALID_OFFSET) {
+            growIndices(range.indexCount);
+            range.firstIndex = indices.allocate(range.indexCount);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(range.baseVertex) * format.stride,
+                        packedVertices.size(), packedVertices.data());
+        // through COPY_WRITE so the bound VAO's element buffer is left alone
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(range.firstIndex) * sizeof(unsigned int),
+                        meshIndices.size() * sizeof(unsigned int), meshIndices.data());
+        return range;
+    }
+
+    void remove(GeometryRange& range)
+    {
+        if (!range.valid())
+            return;
+        vertices.free(range.baseVertex, range.vertexCount);
+        indices.free(range.firstIndex, range.indexCount);
+        range = GeometryRange{};
+    }
+};
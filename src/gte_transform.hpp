@@ -0,0 +1,420 @@
+// Fixed point vertex transform modelled on the PS1 GTE (RTPS)
+//
+// Vertices are int16 in SoA arrays (object space * vertex scale), the
+// rotation / scale matrix is Q3.12 and the translation is in vertex units, so
+//
+//   MAC_i = (TR_i << 12) + sum_j R_ij * V_j,  IR_i = MAC_i >> 12
+//   SZ    = clamp(IR_3, 0, 0xFFFF)
+//   n     = H / SZ in 1.16 fixed point, from the GTE's 257 entry reciprocal
+//           table and two Newton-Raphson steps (saturates at 0x1FFFF)
+//   SX    = OFX + (IR_1 * n) >> 16,  SY = OFY + (IR_2 * n) >> 16
+//
+// Screen coordinates are whole pixels: the authentic PS1 vertex snapping.
+// Camera space follows the PS1 convention (x right, y down, z into the
+// screen); GteMatrixFromGL converts a GL model-view matrix to it.
+//
+// The SSE2 path transforms 8 vertices per step with _mm_madd_epi16 on
+// interleaved (x, y) / (z, 1) pairs and divides and projects 4 at a time
+// (GteDivide4 recomputes the table entries); with AVX2 the same runs 16
+// vertices per step and gathers the table (GteDivide8). Both give exactly
+// the scalar results. The float loop in bench/gte_transform_bench.cpp
+// auto-vectorizes at -O3 once SSE4.1 or AVX2 is enabled: there the SSE2 path
+// only breaks even and the AVX2 path is the one ahead (the bench prints the
+// build it measured).
+//
+// Range: like the GTE (44 bit accumulators) the sums are meant to stay in
+// 32 bits here, which holds for row sums of |R| up to 4.0 and |TR| < 2^18.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define GTE_SSE 1
+#endif
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define GTE_AVX2 1
+#endif
+
+const int GTE_FRACTION_BITS = 12; // Q3.12
+const int GTE_SCREEN_MIN = -1024, GTE_SCREEN_MAX = 1023; // 11 bit screen coordinates
+const float GTE_VERTEX_SCALE = 256.0f; // default: 1.0 = 256 units, +-128 units in object space
+
+struct GteMatrix {
+    int16_t r[3][3]; // Q3.12
+    int32_t tr[3];   // vertex units
+};
+
+struct GteProjection {
+    int32_t h = 0;          // distance of the projection plane in pixels
+    int32_t ofx = 0, ofy = 0; // screen center in pixels
+};
+
+struct GteVertices {
+    std::vector<int16_t> x, y, z;
+
+    size_t size() const { return x.size(); }
+};
+
+struct GteScreen {
+    std::vector<int16_t> sx, sy;
+    std::vector<uint16_t> sz; // depth in vertex units, for ordering tables / z sorting
+
+    void resize(size_t count)
+    {
+        sx.resize(count);
+        sy.resize(count);
+        sz.resize(count);
+    }
+};
+
+struct GteReciprocalTable {
+    uint8_t unr[0x101];
+    int32_t divisor[0x101]; // unr + 0x101, for the AVX2 gather
+
+    GteReciprocalTable()
+    {
+        for (int i = 0; i <= 0x100; i++) {
+            unr[i] = static_cast<uint8_t>(std::max(0, (0x40000 / (i + 0x100) + 1) / 2 - 0x101));
+            divisor[i] = unr[i] + 0x101;
+        }
+    }
+};
+
+const GteReciprocalTable GTE_RECIPROCAL_TABLE;
+
+inline int GteLeadingZeros16(uint32_t value)
+{
+#if defined(__GNUC__)
+    return value ? __builtin_clz(value) - 16 : 16;
+#else
+    int zeros = 16;
+    while (value) {
+        value >>= 1;
+        zeros--;
+    }
+    return zeros;
+#endif
+}
+
+// h / sz in 1.16 fixed point (UNR division), 0x1FFFF on overflow
+inline uint32_t GteDivide(uint32_t h, uint32_t sz)
+{
+    if (h >= sz * 2)
+        return 0x1FFFF;
+    int shift = GteLeadingZeros16(sz);
+    uint64_t n = uint64_t(h) << shift;
+    uint32_t d = sz << shift; // 0x8000..0xFFFF
+    uint32_t u = GTE_RECIPROCAL_TABLE.unr[(d - 0x7FC0) >> 7] + 0x101;
+    d = (0x2000080 - d * u) >> 8;
+    d = (0x0000080 + d * u) >> 8;
+    return static_cast<uint32_t>(std::min<uint64_t>(0x1FFFF, (n * d + 0x8000) >> 16));
+}
+
+inline int16_t GteSaturate16(int32_t value)
+{
+    return static_cast<int16_t>(std::clamp(value, -0x8000, 0x7FFF));
+}
+
+inline int16_t GteScreenClamp(int32_t value)
+{
+    return static_cast<int16_t>(std::clamp(value, GTE_SCREEN_MIN, GTE_SCREEN_MAX));
+}
+
+// floor(ir * n / 65536), ir int16, n < 2^17
+inline int32_t GteScale(int32_t ir, uint32_t n)
+{
+    return static_cast<int32_t>((int64_t(ir) * n) >> 16);
+}
+
+// Q3.12 matrix from a GL model-view matrix (camera looks down -z, y up) for
+// vertices stored as object space * vertexScale; y and z are flipped
+GteMatrix GteMatrixFromGL(const glm::mat4& modelView, float vertexScale)
+{
+    GteMatrix m;
+    const float flip[3] = { 1.0f, -1.0f, -1.0f };
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 3; col++)
+            m.r[row][col] = GteSaturate16(static_cast<int32_t>(std::lround(modelView[col][row] * flip[row] * 4096.0f)));
+        m.tr[row] = static_cast<int32_t>(std::lround(modelView[3][row] * flip[row] * vertexScale));
+    }
+    return m;
+}
+
+// Projection plane for a vertical field of view and screen size, as glm::perspective
+GteProjection GteProjectionFor(float fovY, int width, int height)
+{
+    GteProjection p;
+    p.h = static_cast<int32_t>(std::lround(height * 0.5f / std::tan(fovY * 0.5f)));
+    p.ofx = width / 2;
+    p.ofy = height / 2;
+    return p;
+}
+
+// Same from a glm::perspective matrix, for square pixels (width / height = its aspect)
+GteProjection GteProjectionFromGL(const glm::mat4& projection, int width, int height)
+{
+    GteProjection p;
+    p.h = static_cast<int32_t>(std::lround(height * 0.5f * projection[1][1]));
+    p.ofx = width / 2;
+    p.ofy = height / 2;
+    return p;
+}
+
+// Positions * vertexScale, rounded and saturated to int16
+void GteQuantizeVertices(const std::vector<glm::vec3>& positions, float vertexScale, GteVertices& out)
+{
+    out.x.resize(positions.size());
+    out.y.resize(positions.size());
+    out.z.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        out.x[i] = GteSaturate16(static_cast<int32_t>(std::lround(positions[i].x * vertexScale)));
+        out.y[i] = GteSaturate16(static_cast<int32_t>(std::lround(positions[i].y * vertexScale)));
+        out.z[i] = GteSaturate16(static_cast<int32_t>(std::lround(positions[i].z * vertexScale)));
+    }
+}
+
+// One vertex, the reference for the SIMD path
+inline void GteTransformVertex(const GteMatrix& m, const GteProjection& p, int16_t x, int16_t y, int16_t z,
+                               int16_t& sx, int16_t& sy, uint16_t& sz)
+{
+    int32_t ir[3];
+    for (int row = 0; row < 3; row++) {
+        int32_t mac = m.tr[row] * (1 << GTE_FRACTION_BITS) + m.r[row][0] * x + m.r[row][1] * y + m.r[row][2] * z;
+        ir[row] = mac >> GTE_FRACTION_BITS;
+    }
+    sz = static_cast<uint16_t>(std::clamp(ir[2], 0, 0xFFFF));
+    uint32_t n = GteDivide(p.h, sz);
+    sx = GteScreenClamp(p.ofx + GteScale(GteSaturate16(ir[0]), n));
+    sy = GteScreenClamp(p.ofy + GteScale(GteSaturate16(ir[1]), n));
+}
+
+void GteTransformScalar(const GteMatrix& m, const GteProjection& p, const GteVertices& in, size_t first,
+                        size_t last, GteScreen& out)
+{
+    for (size_t i = first; i < last; i++)
+        GteTransformVertex(m, p, in.x[i], in.y[i], in.z[i], out.sx[i], out.sy[i], out.sz[i]);
+}
+
+#if defined(GTE_SSE)
+// floor(ir * n / 65536) for 4 lanes, ir saturated int16 and n < 2^17 as int32
+inline __m128i GteScale4(__m128i ir, __m128i n)
+{
+    __m128i sign = _mm_srai_epi32(ir, 31);
+    __m128i magnitude = _mm_sub_epi32(_mm_xor_si128(ir, sign), sign); // <= 0x8000, product < 2^32
+    __m128i roundUp = _mm_and_si128(sign, _mm_set1_epi32(0xFFFF));   // floor of negatives: -ceil(|p|)
+    __m128i even = _mm_mul_epu32(magnitude, n);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(magnitude, 32), _mm_srli_epi64(n, 32));
+    even = _mm_srli_epi64(_mm_add_epi64(even, _mm_and_si128(roundUp, _mm_set_epi32(0, -1, 0, -1))), 16);
+    odd = _mm_srli_epi64(_mm_add_epi64(odd, _mm_and_si128(_mm_srli_epi64(roundUp, 32), _mm_set_epi32(0, -1, 0, -1))), 16);
+    __m128i scaled = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+    return _mm_sub_epi32(_mm_xor_si128(scaled, sign), sign);
+}
+
+// Low 32 bits of a * b per lane (SSE2 has no _mm_mullo_epi32)
+inline __m128i GteMul4(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// GteDivide for 4 lanes of sz (0..0xFFFF as int32), bit identical. The
+// normalizing shift comes from the float exponent of sz, and the UNR table
+// entry is recomputed instead of gathered: 0x40000 / (i + 0x100) in float
+// truncates exactly, the quotient is never within 1/512 of an integer.
+inline __m128i GteDivide4(int32_t h, __m128i sz)
+{
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i hv = _mm_set1_epi32(h);
+    __m128i saturate = _mm_cmpgt_epi32(_mm_add_epi32(hv, one), _mm_add_epi32(sz, sz)); // h >= sz * 2
+    __m128i nonZero = _mm_or_si128(sz, _mm_and_si128(_mm_cmpeq_epi32(sz, _mm_setzero_si128()), one));
+
+    // 2^(15 - floor(log2 sz)), as float bits and back
+    __m128i exponent = _mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(nonZero)), 23); // 127 + floor(log2 sz)
+    __m128i scale = _mm_cvttps_epi32(_mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 15 + 127), exponent), 23)));
+    __m128i n = GteMul4(hv, scale);
+    __m128i d = _mm_mullo_epi16(nonZero, scale); // 0x8000..0xFFFF, both factors and the product fit 16 bits
+
+    __m128i index = _mm_srli_epi32(_mm_sub_epi32(d, _mm_set1_epi32(0x7FC0)), 7);
+    __m128i q = _mm_cvttps_epi32(_mm_div_ps(_mm_set1_ps(float(0x40000)), _mm_cvtepi32_ps(_mm_add_epi32(index, _mm_set1_epi32(0x100)))));
+    __m128i u = _mm_srli_epi32(_mm_add_epi32(q, one), 1);
+    __m128i low = _mm_cmplt_epi32(u, _mm_set1_epi32(0x101));
+    u = _mm_or_si128(_mm_andnot_si128(low, u), _mm_and_si128(low, _mm_set1_epi32(0x101))); // unr + 0x101
+
+    d = _mm_srli_epi32(_mm_sub_epi32(_mm_set1_epi32(0x2000080), GteMul4(d, u)), 8);
+    d = _mm_srli_epi32(_mm_add_epi32(_mm_set1_epi32(0x80), GteMul4(d, u)), 8);
+
+    // (n * d + 0x8000) >> 16, below 2^18 whenever h < sz * 2
+    const __m128i roundBit = _mm_set_epi32(0, 0x8000, 0, 0x8000);
+    __m128i even = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epu32(n, d), roundBit), 16);
+    __m128i odd = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(n, 32), _mm_srli_epi64(d, 32)), roundBit), 16);
+    __m128i result = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                        _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+
+    const __m128i maxN = _mm_set1_epi32(0x1FFFF);
+    __m128i big = _mm_or_si128(saturate, _mm_cmpgt_epi32(result, maxN));
+    return _mm_or_si128(_mm_andnot_si128(big, result), _mm_and_si128(big, maxN));
+}
+#endif
+
+#if defined(GTE_AVX2)
+// floor(ir * n / 65536) for 8 lanes: bits 16..47 of the signed 64 bit product
+inline __m256i GteScale8(__m256i ir, __m256i n)
+{
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epi32(ir, n), 16);
+    __m256i odd = _mm256_srli_epi64(_mm256_mul_epi32(_mm256_srli_epi64(ir, 32), _mm256_srli_epi64(n, 32)), 16);
+    return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+// GteDivide for 8 lanes of sz (0..0xFFFF as int32), bit identical: variable
+// shifts normalize sz, the UNR table is gathered
+inline __m256i GteDivide8(int32_t h, __m256i sz)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i hv = _mm256_set1_epi32(h);
+    __m256i saturate = _mm256_cmpgt_epi32(_mm256_add_epi32(hv, one), _mm256_add_epi32(sz, sz)); // h >= sz * 2
+    __m256i nonZero = _mm256_max_epi32(sz, one);
+
+    // 15 - floor(log2 sz) from the float exponent
+    __m256i exponent = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(nonZero)), 23);
+    __m256i shift = _mm256_sub_epi32(_mm256_set1_epi32(127 + 15), exponent);
+    __m256i n = _mm256_sllv_epi32(hv, shift);
+    __m256i d = _mm256_sllv_epi32(nonZero, shift); // 0x8000..0xFFFF
+
+    __m256i index = _mm256_srli_epi32(_mm256_sub_epi32(d, _mm256_set1_epi32(0x7FC0)), 7);
+    __m256i u = _mm256_i32gather_epi32(GTE_RECIPROCAL_TABLE.divisor, index, 4);
+    d = _mm256_srli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(0x2000080), _mm256_mullo_epi32(d, u)), 8);
+    d = _mm256_srli_epi32(_mm256_add_epi32(_mm256_set1_epi32(0x80), _mm256_mullo_epi32(d, u)), 8);
+
+    // (n * d + 0x8000) >> 16, below 2^18 whenever h < sz * 2
+    const __m256i roundBit = _mm256_set1_epi64x(0x8000);
+    __m256i even = _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epu32(n, d), roundBit), 16);
+    __m256i odd = _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(n, 32), _mm256_srli_epi64(d, 32)), roundBit), 16);
+    __m256i result = _mm256_min_epu32(_mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA), _mm256_set1_epi32(0x1FFFF));
+    return _mm256_blendv_epi8(result, _mm256_set1_epi32(0x1FFFF), saturate);
+}
+#endif
+
+// All vertices of in, out is resized to match
+void GteTransform(const GteMatrix& m, const GteProjection& p, const GteVertices& in, GteScreen& out)
+{
+    const size_t count = in.size();
+    out.resize(count);
+    size_t i = 0;
+
+#if defined(GTE_AVX2)
+    // same as the SSE2 loop below, 16 vertices per step
+    {
+        __m256i rowXY[3], rowZ[3], rowT[3];
+        for (int row = 0; row < 3; row++) {
+            rowXY[row] = _mm256_set1_epi32(static_cast<int32_t>(uint16_t(m.r[row][0]) | (uint32_t(uint16_t(m.r[row][1])) << 16)));
+            rowZ[row] = _mm256_set1_epi32(uint16_t(m.r[row][2]));
+            rowT[row] = _mm256_set1_epi32(m.tr[row] * (1 << GTE_FRACTION_BITS));
+        }
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ofx = _mm256_set1_epi32(p.ofx), ofy = _mm256_set1_epi32(p.ofy);
+        const __m256i irMin = _mm256_set1_epi32(-0x8000), irMax = _mm256_set1_epi32(0x7FFF);
+        const __m256i screenMin = _mm256_set1_epi16(GTE_SCREEN_MIN), screenMax = _mm256_set1_epi16(GTE_SCREEN_MAX);
+
+        for (; i + 16 <= count; i += 16) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&in.x[i]));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&in.y[i]));
+            __m256i z = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&in.z[i]));
+            // unpack / pack work within 128 bit lanes: lo holds vertices 0-3 and 8-11,
+            // hi 4-7 and 12-15, and packing (lo, hi) restores the order
+            __m256i xyLo = _mm256_unpacklo_epi16(x, y), xyHi = _mm256_unpackhi_epi16(x, y);
+            __m256i zLo = _mm256_unpacklo_epi16(z, zero), zHi = _mm256_unpackhi_epi16(z, zero);
+
+            __m256i ir[3][2];
+            for (int row = 0; row < 3; row++) {
+                __m256i lo = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(xyLo, rowXY[row]), _mm256_madd_epi16(zLo, rowZ[row])), rowT[row]);
+                __m256i hi = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(xyHi, rowXY[row]), _mm256_madd_epi16(zHi, rowZ[row])), rowT[row]);
+                ir[row][0] = _mm256_srai_epi32(lo, GTE_FRACTION_BITS);
+                ir[row][1] = _mm256_srai_epi32(hi, GTE_FRACTION_BITS);
+            }
+
+            __m256i szLo = _mm256_min_epi32(_mm256_max_epi32(ir[2][0], zero), _mm256_set1_epi32(0xFFFF));
+            __m256i szHi = _mm256_min_epi32(_mm256_max_epi32(ir[2][1], zero), _mm256_set1_epi32(0xFFFF));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.sz[i]), _mm256_packus_epi32(szLo, szHi));
+
+            __m256i nLo = GteDivide8(p.h, szLo), nHi = GteDivide8(p.h, szHi);
+            __m256i ir1a = _mm256_min_epi32(_mm256_max_epi32(ir[0][0], irMin), irMax);
+            __m256i ir1b = _mm256_min_epi32(_mm256_max_epi32(ir[0][1], irMin), irMax);
+            __m256i ir2a = _mm256_min_epi32(_mm256_max_epi32(ir[1][0], irMin), irMax);
+            __m256i ir2b = _mm256_min_epi32(_mm256_max_epi32(ir[1][1], irMin), irMax);
+
+            __m256i sx = _mm256_packs_epi32(_mm256_add_epi32(ofx, GteScale8(ir1a, nLo)), _mm256_add_epi32(ofx, GteScale8(ir1b, nHi)));
+            __m256i sy = _mm256_packs_epi32(_mm256_add_epi32(ofy, GteScale8(ir2a, nLo)), _mm256_add_epi32(ofy, GteScale8(ir2b, nHi)));
+            sx = _mm256_min_epi16(_mm256_max_epi16(sx, screenMin), screenMax);
+            sy = _mm256_min_epi16(_mm256_max_epi16(sy, screenMin), screenMax);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.sx[i]), sx);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.sy[i]), sy);
+        }
+    }
+#endif
+
+#if defined(GTE_SSE)
+    // per row: (r0, r1) against interleaved (x, y), (r2, 0) against (z, 0), TR << 12 added
+    __m128i rowXY[3], rowZ[3], rowT[3];
+    for (int row = 0; row < 3; row++) {
+        rowXY[row] = _mm_set1_epi32(static_cast<int32_t>(uint16_t(m.r[row][0]) | (uint32_t(uint16_t(m.r[row][1])) << 16)));
+        rowZ[row] = _mm_set1_epi32(uint16_t(m.r[row][2]));
+        rowT[row] = _mm_set1_epi32(m.tr[row] * (1 << GTE_FRACTION_BITS));
+    }
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ofx = _mm_set1_epi32(p.ofx), ofy = _mm_set1_epi32(p.ofy);
+    const __m128i screenMin = _mm_set1_epi16(GTE_SCREEN_MIN), screenMax = _mm_set1_epi16(GTE_SCREEN_MAX);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in.x[i]));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in.y[i]));
+        __m128i z = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in.z[i]));
+        __m128i xyLo = _mm_unpacklo_epi16(x, y), xyHi = _mm_unpackhi_epi16(x, y);
+        __m128i zLo = _mm_unpacklo_epi16(z, zero), zHi = _mm_unpackhi_epi16(z, zero);
+
+        __m128i ir[3][2];
+        for (int row = 0; row < 3; row++) {
+            __m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(xyLo, rowXY[row]), _mm_madd_epi16(zLo, rowZ[row])), rowT[row]);
+            __m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(xyHi, rowXY[row]), _mm_madd_epi16(zHi, rowZ[row])), rowT[row]);
+            ir[row][0] = _mm_srai_epi32(lo, GTE_FRACTION_BITS);
+            ir[row][1] = _mm_srai_epi32(hi, GTE_FRACTION_BITS);
+        }
+
+        // SZ = clamp(IR3, 0, 0xFFFF): signed saturation to 0..0x7FFF would cut the top
+        // bit, so clamp negatives to 0 and keep the low 16 bits of the rest
+        __m128i szLo = _mm_andnot_si128(_mm_srai_epi32(ir[2][0], 31), ir[2][0]);
+        __m128i szHi = _mm_andnot_si128(_mm_srai_epi32(ir[2][1], 31), ir[2][1]);
+        __m128i bigLo = _mm_cmpgt_epi32(szLo, _mm_set1_epi32(0xFFFF)), bigHi = _mm_cmpgt_epi32(szHi, _mm_set1_epi32(0xFFFF));
+        szLo = _mm_or_si128(_mm_andnot_si128(bigLo, szLo), _mm_and_si128(bigLo, _mm_set1_epi32(0xFFFF)));
+        szHi = _mm_or_si128(_mm_andnot_si128(bigHi, szHi), _mm_and_si128(bigHi, _mm_set1_epi32(0xFFFF)));
+        // bias to signed, pack, unbias: packs of 0..0xFFFF as is
+        const __m128i bias = _mm_set1_epi32(0x8000);
+        __m128i szPacked = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(szLo, bias), _mm_sub_epi32(szHi, bias)),
+                                         _mm_set1_epi16(-0x8000));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.sz[i]), szPacked);
+
+        __m128i nLo = GteDivide4(p.h, szLo), nHi = GteDivide4(p.h, szHi);
+
+        // IR1 / IR2 saturate to int16 before the projection, like the GTE
+        __m128i ir1 = _mm_packs_epi32(ir[0][0], ir[0][1]);
+        __m128i ir2 = _mm_packs_epi32(ir[1][0], ir[1][1]);
+        __m128i ir1a = _mm_srai_epi32(_mm_unpacklo_epi16(zero, ir1), 16), ir1b = _mm_srai_epi32(_mm_unpackhi_epi16(zero, ir1), 16);
+        __m128i ir2a = _mm_srai_epi32(_mm_unpacklo_epi16(zero, ir2), 16), ir2b = _mm_srai_epi32(_mm_unpackhi_epi16(zero, ir2), 16);
+
+        __m128i sx = _mm_packs_epi32(_mm_add_epi32(ofx, GteScale4(ir1a, nLo)), _mm_add_epi32(ofx, GteScale4(ir1b, nHi)));
+        __m128i sy = _mm_packs_epi32(_mm_add_epi32(ofy, GteScale4(ir2a, nLo)), _mm_add_epi32(ofy, GteScale4(ir2b, nHi)));
+        sx = _mm_min_epi16(_mm_max_epi16(sx, screenMin), screenMax);
+        sy = _mm_min_epi16(_mm_max_epi16(sy, screenMin), screenMax);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.sx[i]), sx);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.sy[i]), sy);
+    }
+#endif
+    GteTransformScalar(m, p, in, i, count, out);
+}
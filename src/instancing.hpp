@@ -0,0 +1,23 @@
+// Instanced drawing of GameObjects that share a mesh
+//
+// The RenderQueue hands runs of consecutive packets with the same mesh (mesh
+// and texture go together) to DrawInstanced, which streams their model matrices
+// into the mesh's instance buffer and draws the run with one
+// glDrawElementsInstanced.
+#pragma once
+
+#include <vector>
+
+// Expects the instanced program bound, texture and VAO of gpu bound
+void DrawInstanced(GpuMesh& gpu, const glm::mat4* matrices, size_t count)
+{
+    // orphan + refill so we never wait on last frame's draw
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO_instances);
+    if (count > gpu.instanceCapacity)
+        gpu.instanceCapacity = count + count / 2;
+    glBufferData(GL_ARRAY_BUFFER, gpu.instanceCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), matrices);
+
+    glDrawElementsInstanced(GL_TRIANGLES, gpu.indexCount, GL_UNSIGNED_INT, (void*)0,
+                            static_cast<GLsizei>(count));
+}
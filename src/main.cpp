@@ -5,62 +5,327 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <cstring>
 #include <iostream>
 
 #include "file_loader.hpp" // loadFile to string implementation
 #include "obj_loader.hpp"
+#include "mesh_registry.hpp"
 #include "game_objects.hpp"
+#include "instancing.hpp"
+#include "geometry_pool.hpp"
+#include "texture_pool.hpp"
+#include "texture_atlas.hpp"
+#include "render_target.hpp"
+#include "dynamic_resolution.hpp"
+#include "multi_draw.hpp"
+#include "render_queue.hpp"
+#include "frustum_culling.hpp"
+#include "spatial_index.hpp"
+#include "occlusion_culling.hpp"
+#include "software_rasterizer.hpp"
+#include "thread_pool.hpp"
+#include "shader_program.hpp"
 #include "camera.hpp"
 
 // Load shader code from files
 std::string vertexCode = loadFile("shaders/vertex_shader.glsl");
 std::string fragmentCode = loadFile("shaders/fragment_shader.glsl");
+std::string instancedVertexCode = loadFile("shaders/vertex_shader_instanced.glsl");
+// no #version, MultiDrawRenderer picks 430 or 330
+std::string multiDrawVertexCode = loadFile("shaders/vertex_shader_mdi.glsl");
+std::string multiDrawFragmentCode = loadFile("shaders/fragment_shader_mdi.glsl");
 
 // Convert to C-style strings for OpenGL
 const char* vertexShaderSource = vertexCode.c_str();
 const char* fragmentShaderSource = fragmentCode.c_str();
+const char* instancedVertexShaderSource = instancedVertexCode.c_str();
 
-GLuint createShader(GLenum type, const char* src) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &src, nullptr);
-    glCompileShader(shader);
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "Shader compilation error:\n" << infoLog << std::endl;
+// The demo scene: two cubes sharing a mesh and a colored one (the occluder)
+void BuildScene(MeshRegistry& meshRegistry, std::vector<GameObject>& sceneObjects, const Mesh& mesh, const Mesh& colormesh)
+{
+    // ============ obj import test (1) ============
+    MeshHandle cubeMesh = meshRegistry.acquire("assets/cube-tex.obj", mesh);
+    
+    GameObject Cube1;
+    
+    Cube1.position = glm::vec3(-1.0f, 0.0f, -1.0f);
+    Cube1.addMesh(meshRegistry, cubeMesh);
+    
+    sceneObjects.push_back(Cube1); // add to list of meshes
+    
+    // ============ obj import test (1.5) ============
+    GameObject Cube2;
+    
+    Cube2.position = glm::vec3(-1.0f, 0.0f, 1.0f);
+    Cube2.addMesh(meshRegistry, cubeMesh); // same GPU mesh as Cube1
+    
+    sceneObjects.push_back(Cube2); // add to list of meshes
+    
+    // ============ obj import test (2) ============
+    MeshHandle colorCubeMesh = meshRegistry.acquire("assets/cube-tex-colored.obj", colormesh);
+    
+    GameObject Cube3;
+    
+    Cube3.position = glm::vec3(0.0f, 0.0f, 0.0f);
+    Cube3.addMesh(meshRegistry, colorCubeMesh);
+    Cube3.occluder = true; // hides what is behind it in the occlusion pass
+    
+    sceneObjects.push_back(Cube3); // add to list of meshes
+    
+    // objects hold their own references now
+    meshRegistry.release(cubeMesh);
+    meshRegistry.release(colorCubeMesh);
+}
+
+// State bits for a draw of material, selected once per draw
+uint32_t SoftwareRasterStateFor(const Material& material, bool textured, bool hasNormals, bool lighting, bool dither)
+{
+    uint32_t state = RASTER_DEPTH_TEST;
+    if (textured)
+        state |= RASTER_TEXTURED;
+    if (lighting && material.illum >= 1 && hasNormals)
+        state |= RASTER_GOURAUD;
+    state |= material.d < 1.0f ? RASTER_BLEND : RASTER_DEPTH_WRITE;
+    // like the PS1 GPU, only shaded and blended polygons are dithered
+    if (dither && (state & (RASTER_GOURAUD | RASTER_BLEND)))
+        state |= RASTER_DITHER;
+    return state;
+}
+
+// Draw list from the sorted render queue (opaque front to back, then
+// transparent back to front), the registry must hold software meshes
+void BuildSoftwareDraws(const RenderQueue& queue, const std::vector<GameObject>& objects,
+                        const MeshRegistry& registry, const SoftwareRasterizer& rasterizer,
+                        const glm::mat4& view, const glm::mat4& projection, std::vector<SoftwareDraw>& draws)
+{
+    const glm::mat4 viewProjection = projection * view;
+    const GteProjection gteProjection = GteProjectionFromGL(projection, rasterizer.width, rasterizer.height);
+    draws.clear();
+    for (const DrawPacket& packet : queue.packets) {
+        const GameObject& obj = objects[packet.object];
+        const GpuMesh& gpu = registry.get(obj.mesh);
+        if (gpu.cpuIndices.empty())
+            continue;
+
+        SoftwareDraw draw;
+        draw.positions = gpu.cpuPositions.data();
+        draw.texcoords = gpu.cpuTexcoords.size() == gpu.cpuPositions.size() ? gpu.cpuTexcoords.data() : nullptr;
+        draw.indices = gpu.cpuIndices.data();
+        draw.indexCount = gpu.cpuIndices.size();
+        draw.mvp = viewProjection * obj.model;
+        if (rasterizer.gteVertices && gpu.gteVertices.size() == gpu.cpuPositions.size()) {
+            draw.gteVertices = &gpu.gteVertices;
+            draw.gteMatrix = GteMatrixFromGL(view * obj.model, GTE_VERTEX_SCALE);
+            draw.gteProjection = gteProjection;
+        }
+        draw.texture = registry.softwareTextures ? registry.softwareTextures->get(gpu.softwareTexture) : nullptr;
+        draw.vramTexture = registry.vramTextures ? registry.vramTextures->use(gpu.vramTexture) : nullptr;
+        glm::vec3 kd = glm::clamp(gpu.material.Kd, 0.0f, 1.0f) * 255.0f;
+        draw.color = PackARGB(int(kd.r), int(kd.g), int(kd.b), 255);
+        draw.alpha = static_cast<uint8_t>(std::clamp(gpu.material.d, 0.0f, 1.0f) * 255.0f);
+        bool hasNormals = gpu.cpuNormals.size() == gpu.cpuPositions.size();
+        draw.normals = hasNormals ? gpu.cpuNormals.data() : nullptr;
+        draw.state = SoftwareRasterStateFor(gpu.material, draw.texture || draw.vramTexture, hasNormals,
+                                            rasterizer.lighting, rasterizer.dither);
+        if (draw.vramTexture)
+            draw.state |= RASTER_VRAM;
+        if (draw.state & RASTER_GOURAUD) {
+            // normals transform with the inverse transpose, so n . (M^-1 L) = (M^-T n) . L
+            draw.light = glm::normalize(glm::inverse(glm::mat3(obj.model)) * rasterizer.lightDirection);
+            draw.ambient = rasterizer.ambient;
+        }
+        draws.push_back(draw);
     }
-    return shader;
 }
 
-int main() {
+// CPU backend: same scene drawn by the SoftwareRasterizer into an SDL
+// streaming texture, no GL calls at all. With useVram the textures live in
+// the emulated 1 MB PS1 VRAM and are sampled from there.
+int RunSoftwareRenderer(int width, int height, bool useVram)
+{
+    SDL_Window* window = SDL_CreateWindow("Software PSX-Project",
+        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_SHOWN);
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, 0); // accelerated if possible, SDL's own software renderer otherwise
+    if (!window || !renderer) {
+        std::cerr << "Failed to create the software renderer: " << SDL_GetError() << "\n";
+        return -1;
+    }
+    SDL_SetRelativeMouseMode(SDL_TRUE);
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+    
+    const float nearPlane = 0.1f, farPlane = 100.0f;
+    glm::mat4 Projection = glm::perspective(glm::radians(45.0f), (float) width / (float)height, nearPlane, farPlane);
+    
+    ThreadPool workerPool;
+    workerPool.start();
+    
+    // meshes stay on the CPU, textures in memory (no atlas, its pages live in the GL TexturePool)
+    SoftwareTexturePool softwareTextures;
+    VramTexturePool vramTextures;
+    vramTextures.workers = &workerPool;
+    vramTextures.reserve(VRAM_DISPLAY_AREA);
+    MeshRegistry meshRegistry;
+    meshRegistry.softwareTextures = &softwareTextures;
+    if (useVram)
+        meshRegistry.vramTextures = &vramTextures;
+    std::vector<GameObject> sceneObjects;
+    BuildScene(meshRegistry, sceneObjects, LoadOBJ("assets/cube-tex.obj"), LoadOBJ("assets/cube-tex-colored.obj"));
+    
+    SpatialIndex spatialIndex;
+    std::vector<uint32_t> visibleObjects;
+    RenderQueue renderQueue;
+    std::vector<SoftwareDraw> draws;
+    
+    // V cycles the internal resolution like on the GL path, the streaming texture is recreated
+    SoftwareRasterizer rasterizer;
+    SDL_Texture* frameTexture = nullptr;
+    int internalResolution = 0;
+    auto resizeFrame = [&](int index) {
+        Resolution r = INTERNAL_RESOLUTIONS[index];
+        if (!r.width)
+            r = Resolution{ width, height };
+        rasterizer.resize(r.width, r.height);
+        if (frameTexture)
+            SDL_DestroyTexture(frameTexture);
+        frameTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, r.width, r.height);
+        SDL_RenderSetLogicalSize(renderer, r.width, r.height); // nearest upscale, aspect kept
+    };
+    resizeFrame(internalResolution);
+    
+    Camera camera;
+    Uint64 NOW = SDL_GetPerformanceCounter();
+    Uint64 LAST = 0;
+    float dt = 0;
+    
+    bool running = true;
+    SDL_Event event;
+    while (running) {
+        LAST = NOW;
+        NOW = SDL_GetPerformanceCounter();
+        dt = (float)((NOW - LAST) / (double)SDL_GetPerformanceFrequency());
+        
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT)
+                running = false;
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_v) {
+                internalResolution = (internalResolution + 1) % INTERNAL_RESOLUTION_COUNT;
+                resizeFrame(internalResolution);
+                std::cout << "Internal resolution " << rasterizer.width << "x" << rasterizer.height << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_l) {
+                rasterizer.lighting = !rasterizer.lighting;
+                std::cout << "Gouraud lighting " << (rasterizer.lighting ? "on" : "off") << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_c) {
+                rasterizer.dither = !rasterizer.dither;
+                std::cout << "15 bit dithered output " << (rasterizer.dither ? "on" : "off") << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_g) {
+                rasterizer.gteVertices = !rasterizer.gteVertices;
+                std::cout << "GTE fixed point vertex stage " << (rasterizer.gteVertices ? "on" : "off") << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_t) {
+                softwareTextures.setLayout(
+                    SoftwareTextureLayout((softwareTextures.layout + 1) % SOFTWARE_TEXTURE_LAYOUT_COUNT));
+                std::cout << "Software texture layout " << SoftwareTextureLayoutName(softwareTextures.layout) << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_r) {
+                rasterizer.stats.print();
+                if (useVram)
+                    vramTextures.printStats();
+                else
+                    softwareTextures.printStats();
+            }
+            if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
+                RayHit hit;
+                if (spatialIndex.raycast(camera.position, camera.front, farPlane, hit))
+                    std::cout << "Picked object " << hit.object << " at distance " << hit.distance << "\n";
+                else
+                    std::cout << "Picked nothing\n";
+            }
+            
+            handleMouse(camera, event);
+        }
+        handleKeyboard(camera, dt);
+        
+        glm::mat4 view = getViewMatrix(camera);
+        glm::mat4 viewProjection = Projection * view;
+        SyncSpatialIndex(sceneObjects, meshRegistry, spatialIndex);
+        visibleObjects.clear();
+        spatialIndex.queryFrustum(ExtractFrustum(viewProjection), visibleObjects);
+        SubmitSceneObjects(renderQueue, sceneObjects, visibleObjects, meshRegistry, camera.position, camera.front, farPlane);
+        vramTextures.beginFrame();
+        BuildSoftwareDraws(renderQueue, sceneObjects, meshRegistry, rasterizer, view, Projection, draws);
+        rasterizer.render(draws, &workerPool);
+        
+        SDL_UpdateTexture(frameTexture, nullptr, rasterizer.color.data(), rasterizer.stride * sizeof(uint32_t));
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, frameTexture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+    }
+    
+    for (auto& gameObject : sceneObjects)
+        gameObject.removeMesh(meshRegistry);
+    
+    SDL_DestroyTexture(frameTexture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
+
+int main(int argc, char** argv) {
     SDL_Init(SDL_INIT_VIDEO);
     
+    float width = 800, height = 600; // window format
+    
+    // --software (or no usable OpenGL) runs the CPU rasterizer instead, --vram
+    // also puts its textures in the emulated PS1 VRAM
+    bool software = false, vram = false;
+    for (int i = 1; i < argc; i++) {
+        software |= std::strcmp(argv[i], "--software") == 0;
+        vram |= std::strcmp(argv[i], "--vram") == 0;
+    }
+    if (software || vram)
+        return RunSoftwareRenderer(static_cast<int>(width), static_cast<int>(height), vram);
+    
     SDL_SetRelativeMouseMode(SDL_TRUE);
     
-    // Set OpenGL version to 3.3 core
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    // Try OpenGL 4.3 core (multi draw indirect + SSBO), 3.3 core otherwise
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-
-    float width = 800, height = 600; // window format
     
     SDL_Window* window = SDL_CreateWindow("OpenGL PSX-Project",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
         width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
 
     SDL_GLContext context = SDL_GL_CreateContext(window);
+    if (!context) {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+        context = SDL_GL_CreateContext(window);
+    }
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Failed to initialize GLEW" << std::endl;
-        return -1;
+    if (!context || glewInit() != GLEW_OK) {
+        std::cerr << "No usable OpenGL 3.3 context, falling back to the software renderer" << std::endl;
+        if (context)
+            SDL_GL_DeleteContext(context);
+        SDL_DestroyWindow(window);
+        return RunSoftwareRenderer(static_cast<int>(width), static_cast<int>(height), vram);
     }
+    bool multiDrawIndirect = GLEW_VERSION_4_3;
+    std::cout << "OpenGL " << glGetString(GL_VERSION) << ", multi draw "
+              << (multiDrawIndirect ? "indirect" : "fallback (glDrawElementsBaseVertex loop)") << "\n";
+    // RGB565 is core from 4.1, RGB5 (which drivers may widen) before that
+    GLenum opaque16Format = (GLEW_VERSION_4_1 || GLEW_ARB_ES2_compatibility) ? GL_RGB565 : GL_RGB5;
     
     // cam init test 
     // Projection matrix: 45° Field of View, 4:3 ratio, display range: 0.1 unit <-> 100 units
-    glm::mat4 Projection = glm::perspective(glm::radians(45.0f), (float) width / (float)height, 0.1f, 100.0f);
+    const float nearPlane = 0.1f, farPlane = 100.0f;
+    glm::mat4 Projection = glm::perspective(glm::radians(45.0f), (float) width / (float)height, nearPlane, farPlane);
     // Camera matrix
     //glm::mat4 View = glm::lookAt(
     //    glm::vec3(4,4,3), // Camera is at (4,3,3), in World Space xz is horiz y up
@@ -71,64 +336,121 @@ int main() {
     
     // array of Meshes
     
-    //std::vector<Mesh> sceneMeshes;
+    // GPU meshes shared between objects
+    MeshRegistry meshRegistry;
+    meshRegistry.cpuGeometry = true; // occluders are rasterized on the CPU (O)
     std::vector<GameObject> sceneObjects;
     
-    // ============ obj import test (1) ============
-    Mesh mesh = LoadOBJ("assets/cube-tex.obj");
-    
-    GameObject Cube1;
+    // every mesh also goes into the shared buffers of the multi draw path
+    GeometryPool geometryPool;
+    geometryPool.create(meshRegistry.vertexFormat, 1 << 16, 1 << 18);
+    meshRegistry.geometryPool = &geometryPool;
+    // worker threads for texture compression and the occlusion pass
+    ThreadPool workerPool;
+    workerPool.start();
     
-    Cube1.position = glm::vec3(-1.0f, 0.0f, -1.0f);
-    Cube1.addMesh(mesh);
-    Cube1.sendMesh();
+    // diffuse textures as layers of shared texture arrays, stored as 256 color
+    // CLUT textures (TEXTURE_RGB16 for 16 bit color, TEXTURE_BC for BC1 / BC3
+    // where supported, TEXTURE_RGBA8 for the 32 bit comparison)
+    TexturePool texturePool;
+    texturePool.storage = TEXTURE_CLUT8;
+    texturePool.workers = &workerPool;
+    texturePool.opaque16Format = opaque16Format;
+    meshRegistry.texturePool = &texturePool;
+    // small textures packed into shared pages at load, layout kept across runs
+    TextureAtlas textureAtlas;
+    textureAtlas.dir = meshRegistry.textureDir;
+    textureAtlas.pool = &texturePool;
+    textureAtlas.load();
     
-    sceneObjects.push_back(Cube1); // add to list of meshes
+    Mesh mesh = LoadOBJ("assets/cube-tex.obj", 0, &textureAtlas);
+    Mesh colormesh = LoadOBJ("assets/cube-tex-colored.obj", 0, &textureAtlas);
+    textureAtlas.save();
+    // quantize all textures of the scene in parallel before they are uploaded
+    texturePool.prefetch({ meshRegistry.textureDir + mesh.material.diffuseTexPath,
+                           meshRegistry.textureDir + colormesh.material.diffuseTexPath });
     
-    // ============ obj import test (1.5) ============
-    GameObject Cube2;
+    BuildScene(meshRegistry, sceneObjects, mesh, colormesh);
     
-    Cube2.position = glm::vec3(-1.0f, 0.0f, 1.0f);
-    Cube2.addMesh(mesh);
-    Cube2.sendMesh();
+    // ================================
+    // unbind 
+    glBindVertexArray(0);
     
-    sceneObjects.push_back(Cube2); // add to list of meshes
     
-    // ============ obj import test (2) ============
-    Mesh colormesh = LoadOBJ("assets/cube-tex-colored.obj");
+    // Compile shaders
+    ShaderProgram shaderProgram;
+    shaderProgram.build(vertexShaderSource, fragmentShaderSource);
+    // same fragment shader, model matrix per instance
+    ShaderProgram instancedProgram;
+    instancedProgram.build(instancedVertexShaderSource, fragmentShaderSource);
     
-    GameObject Cube3;
+    // --- Uniform locations are cached at link time ---
+    QueuePrograms queuePrograms;
+    queuePrograms.single = shaderProgram.id;
+    queuePrograms.instanced = instancedProgram.id;
+    queuePrograms.singleModelLoc = shaderProgram.location("Model");
+    queuePrograms.singleAlphaLoc = shaderProgram.location("Alpha");
+    queuePrograms.instancedAlphaLoc = instancedProgram.location("Alpha");
+    queuePrograms.singleLayerLoc = shaderProgram.location("Layer");
+    queuePrograms.instancedLayerLoc = instancedProgram.location("Layer");
+    queuePrograms.singleAtlasRectLoc = shaderProgram.location("AtlasRect");
+    queuePrograms.instancedAtlasRectLoc = instancedProgram.location("AtlasRect");
+    queuePrograms.singleClutLoc = shaderProgram.location("Clut");
+    queuePrograms.instancedClutLoc = instancedProgram.location("Clut");
     
-    Cube3.position = glm::vec3(0.0f, 0.0f, 0.0f);
-    Cube3.addMesh(colormesh);
-    Cube3.sendMesh();
+    // Set samplers to use texture unit 0, this sticks with the program
+    glUseProgram(shaderProgram.id);
+    glUniform1i(shaderProgram.location("diffuseTex"), 0);
+    glUniform1i(shaderProgram.location("clutTex"), CLUT_TEXTURE_UNIT);
+    glUseProgram(instancedProgram.id);
+    glUniform1i(instancedProgram.location("diffuseTex"), 0);
+    glUniform1i(instancedProgram.location("clutTex"), CLUT_TEXTURE_UNIT);
     
-    sceneObjects.push_back(Cube3); // add to list of meshes
+    // all visible objects from the geometry pool in a few calls, toggle with M
+    MultiDrawRenderer multiDraw;
+    multiDraw.create(multiDrawIndirect, geometryPool, multiDrawVertexCode, multiDrawFragmentCode);
+    bool useMultiDraw = multiDrawIndirect;
     
-    // ================================
-    // unbind 
-    glBindVertexArray(0);
+    // View / Projection for all programs, updated once per frame
+    FrameUniformBuffer frameUniforms;
+    frameUniforms.create();
     
+    // objects sharing a mesh are drawn in one call, toggle with I
+    bool useInstancing = true;
     
-    // Compile shaders
-    GLuint vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource);
-    GLuint fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
-    
-    // link
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // sorted draw packets, R prints the bind counters of the last frame
+    RenderQueue renderQueue;
+    RenderStats renderStats;
     
+    // BVH over the world bounds of sceneObjects: culling, picking and range
+    // queries; only frustum survivors are submitted
+    SpatialIndex spatialIndex;
+    std::vector<uint32_t> visibleObjects;
     
-    // --- Get location of the MVP uniform ---
-    GLint mvpLoc = glGetUniformLocation(shaderProgram, "MVP");
+    // software occlusion pass over the frustum survivors, toggle with O
+    OcclusionCuller occlusionCuller;
+    std::vector<uint32_t> unoccludedObjects;
+    bool useOcclusion = true;
     
     glEnable(GL_DEPTH_TEST);
     
+    // the scene renders into a 16 bit color target at a low internal resolution,
+    // C switches to 32 bit, V cycles the resolution (only the target is recreated)
+    RenderTarget sceneTarget;
+    bool use16BitTarget = true;
+    int internalResolution = 0; // INTERNAL_RESOLUTIONS index
+    auto internalSize = [&](int index) {
+        Resolution r = INTERNAL_RESOLUTIONS[index];
+        return r.width ? r : Resolution{ static_cast<int>(width), static_cast<int>(height) };
+    };
+    Resolution initialSize = internalSize(internalResolution);
+    sceneTarget.create(initialSize.width, initialSize.height, opaque16Format);
+    
+    // render scale follows the measured frame time, B toggles it
+    DynamicResolution dynamicResolution;
+    GpuFrameTimer gpuTimer;
+    gpuTimer.create();
+    
     
     Camera camera;    // global or member
     Uint64 NOW = SDL_GetPerformanceCounter();
@@ -148,41 +470,122 @@ int main() {
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT)
                 running = false;
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_i) {
+                useInstancing = !useInstancing;
+                std::cout << "Instancing " << (useInstancing ? "on" : "off") << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_m) {
+                useMultiDraw = !useMultiDraw;
+                std::cout << "Multi draw " << (useMultiDraw ? "on" : "off") << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_o) {
+                useOcclusion = !useOcclusion;
+                std::cout << "Occlusion culling " << (useOcclusion ? "on" : "off") << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_c) {
+                use16BitTarget = !use16BitTarget;
+                sceneTarget.create(sceneTarget.width, sceneTarget.height, use16BitTarget ? opaque16Format : GL_RGBA8);
+                std::cout << "Color target " << (use16BitTarget ? "16" : "32") << " bit\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_v) {
+                internalResolution = (internalResolution + 1) % INTERNAL_RESOLUTION_COUNT;
+                Resolution size = internalSize(internalResolution);
+                sceneTarget.resize(size.width, size.height);
+                dynamicResolution.reset();
+                std::cout << "Internal resolution " << size.width << "x" << size.height << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_b) {
+                dynamicResolution.enabled = !dynamicResolution.enabled;
+                dynamicResolution.reset();
+                std::cout << "Dynamic resolution " << (dynamicResolution.enabled ? "on" : "off") << "\n";
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_r) {
+                renderStats.print();
+                dynamicResolution.print();
+                occlusionCuller.stats.print();
+                texturePool.printStats();
+                textureAtlas.printStats();
+            }
+            // pick the object under the crosshair
+            if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
+                RayHit hit;
+                if (spatialIndex.raycast(camera.position, camera.front, farPlane, hit))
+                    std::cout << "Picked object " << hit.object << " at distance " << hit.distance << "\n";
+                else
+                    std::cout << "Picked nothing\n";
+            }
             
             handleMouse(camera, event);
         }
         handleKeyboard(camera, dt);
         
         
+        sceneTarget.viewScale = dynamicResolution.scale();
+        gpuTimer.begin();
+        sceneTarget.bind();
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        texturePool.bindClut(); // palettes for every draw, the texture may have grown
         
-        glUseProgram(shaderProgram);
+        // Camera data, once per frame
+        FrameUniforms frame;
+        frame.View = getViewMatrix(camera);
+        frame.Projection = Projection;
+        frame.ViewProjection = Projection * frame.View;
+        frame.CameraPos = glm::vec4(camera.position, 1.0f);
+        frameUniforms.update(frame);
         
         // Bind texture
         glActiveTexture(GL_TEXTURE0);
         
-        // Set uniform to use texture unit 
-        GLint texLoc = glGetUniformLocation(shaderProgram, "diffuseTex");
-        glUniform1i(texLoc, 0);
+        Uint64 cullStart = SDL_GetPerformanceCounter();
+        SyncSpatialIndex(sceneObjects, meshRegistry, spatialIndex);
+        visibleObjects.clear();
+        spatialIndex.queryFrustum(ExtractFrustum(frame.ViewProjection), visibleObjects);
+        renderStats.cullMs = (SDL_GetPerformanceCounter() - cullStart) * 1000.0 / SDL_GetPerformanceFrequency();
+        renderStats.objects = sceneObjects.size();
+        renderStats.culled = sceneObjects.size() - visibleObjects.size();
         
-        for (auto& gameObject : sceneObjects) {
-            glm::mat4 View = getViewMatrix(camera);
-            
-            glm::mat4 mvp = Projection * View * gameObject.mesh.model; // take view from player object
-            
-            glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, &mvp[0][0]);
-            glBindTexture(GL_TEXTURE_2D, gameObject.mesh.diffuseTex);
-            glBindVertexArray(gameObject.mesh.VAO);
-            glDrawArrays(GL_TRIANGLES, 0, gameObject.mesh.positions.size());
+        if (useOcclusion) {
+            occlusionCuller.render(sceneObjects, visibleObjects, meshRegistry, frame.ViewProjection, workerPool);
+            occlusionCuller.cull(visibleObjects, sceneObjects, spatialIndex, unoccludedObjects);
+            visibleObjects.swap(unoccludedObjects);
+        } else {
+            occlusionCuller.stats = OcclusionStats{};
         }
         
+        QueueProgram program = useMultiDraw ? PROGRAM_MULTI_DRAW : useInstancing ? PROGRAM_INSTANCED : PROGRAM_SINGLE;
+        SubmitSceneObjects(renderQueue, sceneObjects, visibleObjects, meshRegistry, camera.position, camera.front,
+                           farPlane, program);
+        if (useMultiDraw)
+            renderQueue.executeMultiDraw(sceneObjects, meshRegistry, multiDraw, renderStats);
+        else
+            renderQueue.execute(sceneObjects, meshRegistry, queuePrograms, renderStats);
+        
+        sceneTarget.blitToWindow(static_cast<int>(width), static_cast<int>(height));
+        gpuTimer.end();
+        
+        // CPU time of this frame's work, dt also holds the wait for the previous swap
+        double cpuMs = (SDL_GetPerformanceCounter() - NOW) * 1000.0 / SDL_GetPerformanceFrequency();
+        double gpuMs = -1.0;
+        gpuTimer.poll(gpuMs);
+        dynamicResolution.update(gpuMs, cpuMs);
         SDL_GL_SwapWindow(window);
     }
 
-    glDeleteVertexArrays(1, &mesh.VAO);
-    glDeleteBuffers(1, &mesh.VBO_positions);
-    glDeleteBuffers(1, &mesh.VBO_texcoords);
+    // last reference frees each GPU mesh
+    for (auto& gameObject : sceneObjects)
+        gameObject.removeMesh(meshRegistry);
+    
+    shaderProgram.destroy();
+    instancedProgram.destroy();
+    frameUniforms.destroy();
+    multiDraw.destroy();
+    geometryPool.destroy();
+    texturePool.destroy();
+    sceneTarget.destroy();
+    gpuTimer.destroy();
+    workerPool.stop();
     
     SDL_GL_DeleteContext(context);
     SDL_DestroyWindow(window);
@@ -0,0 +1,66 @@
+// CPU side mesh and material data
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Material {
+    std::string name;
+
+    glm::vec3 Ka = glm::vec3(0.0f);  // Ambient col
+    glm::vec3 Kd = glm::vec3(1.0f);  // Diffuse col
+    glm::vec3 Ks = glm::vec3(0.0f);  // Specular col
+    float Ns = 0.0f;                 // Shine
+    float d = 1.0f;                  // Transparency
+    int illum = 2;                   // illum model
+
+    std::string diffuseTexPath;
+    std::string normalMapPath;
+    std::string specularMapPath;
+
+    //unsigned int diffuseTexID = 0;
+    //unsigned int normalMapID = 0;
+    //unsigned int specularTexID = 0;
+};
+
+// Mesh with associated material and texture
+struct Mesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texcoords;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
+    
+    std::string materialLib;    // Path to .mtl
+    std::string activeMaterial; // active material
+    
+    Material material;
+    
+    // OpenGL textures (the diffuse texture lives in the TexturePool, see MeshRegistry)
+    GLuint specularTex = 0;
+    GLuint normalTex = 0;
+    
+    size_t vertexCount = 0; // unique vertices, indices.size() corners
+    
+    // atlas entry (xy offset, zw scale) to tile wrapping texcoords in, z = 0
+    // if the texcoords are used as they are (see TextureAtlas)
+    glm::vec4 atlasRect = glm::vec4(0.0f);
+    
+    // object space AABB, computed at load
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// Recompute mesh.boundsMin / boundsMax from the positions
+void ComputeMeshBounds(Mesh& mesh)
+{
+    mesh.boundsMin = mesh.boundsMax = glm::vec3(0.0f);
+    if (mesh.positions.empty())
+        return;
+    
+    mesh.boundsMin = mesh.boundsMax = mesh.positions[0];
+    for (const glm::vec3& p : mesh.positions) {
+        mesh.boundsMin = glm::min(mesh.boundsMin, p);
+        mesh.boundsMax = glm::max(mesh.boundsMax, p);
+    }
+}
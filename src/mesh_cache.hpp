@@ -0,0 +1,412 @@
+// Cooked (binary) mesh cache
+//
+// LoadOBJ writes "<file>.obj.cooked" next to the source after parsing and maps it
+// on later runs instead of parsing text again. Layout:
+//
+//   CookedMeshHeader
+//   CookedSection[sectionCount]
+//   section payloads, each aligned to COOKED_ALIGNMENT
+//
+// Vertex/index payloads are the exact arrays uploaded with glBufferData, so a
+// CookedMesh view can be handed to GL without touching the data. The cache is
+// rebuilt whenever the version changes or the .obj / .mtl it was cooked from
+// changed (size + mtime, falling back to a content hash if only mtime differs).
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+
+const char COOKED_MAGIC[8] = { 'P', 'S', 'X', 'M', 'E', 'S', 'H', '\0' };
+const uint32_t COOKED_VERSION = 2;
+const uint64_t COOKED_ALIGNMENT = 64;
+
+enum CookedSectionType : uint32_t {
+    COOKED_POSITIONS = 1,
+    COOKED_TEXCOORDS,
+    COOKED_NORMALS,
+    COOKED_INDICES,
+    COOKED_MATERIAL,   // CookedMaterial
+    COOKED_STRINGS,    // u32 length + bytes, see CookedString
+    COOKED_BOUNDS,     // 2 x vec3, object space AABB min / max
+};
+
+// Size, mtime and content hash of a file the cache was built from
+struct CookedSourceStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t hash = 0;
+};
+
+struct CookedMeshHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t fileSize;
+    CookedSourceStamp obj;
+    CookedSourceStamp mtl;
+};
+
+struct CookedSection {
+    uint32_t type;
+    uint32_t elementSize;
+    uint64_t offset; // from start of file
+    uint64_t count;
+};
+
+// Plain part of Material
+struct CookedMaterial {
+    float Ka[3], Kd[3], Ks[3];
+    float Ns, d;
+    int32_t illum;
+};
+
+// Order of the strings in the COOKED_STRINGS section
+enum CookedString {
+    COOKED_STR_MATERIAL_LIB,
+    COOKED_STR_ACTIVE_MATERIAL,
+    COOKED_STR_MTL_PATH,       // file the material was read from ("" = none)
+    COOKED_STR_MATERIAL_NAME,
+    COOKED_STR_DIFFUSE_TEX,
+    COOKED_STR_NORMAL_MAP,
+    COOKED_STR_SPECULAR_MAP,
+    COOKED_STR_COUNT
+};
+
+// 64 bit hash over 8 byte words, only has to spot changed content
+uint64_t HashBytes(const char* data, size_t size)
+{
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t k;
+        std::memcpy(&k, data + i, 8);
+        k *= 0xC2B2AE3D27D4EB4Full;
+        k ^= k >> 31;
+        h = (h ^ k) * 0x9E3779B97F4A7C15ull;
+    }
+    for (; i < size; i++)
+        h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001B3ull;
+    return h ^ (h >> 29);
+}
+
+// Size/mtime of path, hash only when asked (it reads the whole file)
+bool StampFile(const std::string& path, CookedSourceStamp& stamp, bool withHash)
+{
+    std::error_code ec;
+    stamp.size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+    stamp.mtime = static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    if (ec)
+        return false;
+
+    stamp.hash = 0;
+    if (withHash) {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+        stamp.hash = HashBytes(file.data, file.size);
+    }
+    return true;
+}
+
+// Check path against the stamp it had at cook time. mtime alone changes on a
+// plain checkout/copy, so a differing mtime with equal size falls back to the
+// hash. current (optional) receives the stamp to keep, i.e. with today's mtime.
+bool StampStillValid(const std::string& path, const CookedSourceStamp& cooked, CookedSourceStamp* current = nullptr)
+{
+    CookedSourceStamp now;
+    if (!StampFile(path, now, false) || now.size != cooked.size)
+        return false;
+    if (now.mtime != cooked.mtime && !(StampFile(path, now, true) && now.hash == cooked.hash))
+        return false;
+    if (current) {
+        *current = cooked;
+        current->mtime = now.mtime;
+    }
+    return true;
+}
+
+// Overwrite the source stamp at offset in a cache file after a hash hit, so
+// the next start matches on mtime again instead of hashing the source. The
+// cache must not be mapped while this runs.
+bool RefreshCookedStamp(const std::string& cachePath, size_t offset, const CookedSourceStamp& stamp)
+{
+    std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file)
+        return false;
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(reinterpret_cast<const char*>(&stamp), sizeof(stamp));
+    return static_cast<bool>(file);
+}
+
+std::string CookedMeshPath(const std::string& objPath)
+{
+    return objPath + ".cooked";
+}
+
+// Element size a known section type must have, 0 for unknown types
+inline uint32_t CookedElementSize(uint32_t type)
+{
+    switch (type) {
+    case COOKED_POSITIONS:
+    case COOKED_NORMALS:
+    case COOKED_BOUNDS:
+        return sizeof(glm::vec3);
+    case COOKED_TEXCOORDS:
+        return sizeof(glm::vec2);
+    case COOKED_INDICES:
+        return sizeof(unsigned int);
+    case COOKED_MATERIAL:
+        return sizeof(CookedMaterial);
+    case COOKED_STRINGS:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Read-only view of a mapped cooked mesh, pointers point into the mapping.
+// open() rejects anything a truncated or corrupt file could make read past
+// the mapping: section sizes, element sizes and indices out of range.
+struct CookedMesh {
+    MappedFile file;
+    const CookedMeshHeader* header = nullptr;
+
+    const glm::vec3* positions = nullptr;
+    const glm::vec2* texcoords = nullptr;
+    const glm::vec3* normals = nullptr;
+    const unsigned int* indices = nullptr;
+    size_t positionCount = 0, texcoordCount = 0, normalCount = 0, indexCount = 0;
+
+    const CookedMaterial* material = nullptr;
+    const glm::vec3* bounds = nullptr;
+    std::string strings[COOKED_STR_COUNT];
+
+    bool open(const std::string& path)
+    {
+        if (!file.open(path) || file.size < sizeof(CookedMeshHeader))
+            return false;
+
+        header = reinterpret_cast<const CookedMeshHeader*>(file.data);
+        if (std::memcmp(header->magic, COOKED_MAGIC, 8) != 0 || header->version != COOKED_VERSION ||
+            header->fileSize != file.size ||
+            sizeof(CookedMeshHeader) + header->sectionCount * sizeof(CookedSection) > file.size)
+            return false;
+
+        const CookedSection* sections = reinterpret_cast<const CookedSection*>(file.data + sizeof(CookedMeshHeader));
+        for (uint32_t i = 0; i < header->sectionCount; i++) {
+            const CookedSection& s = sections[i];
+            uint32_t expected = CookedElementSize(s.type);
+            if (expected && s.elementSize != expected)
+                return false;
+            // count * elementSize could wrap, divide instead
+            if (s.offset % COOKED_ALIGNMENT != 0 || s.offset > file.size ||
+                (s.elementSize && s.count > (file.size - s.offset) / s.elementSize))
+                return false;
+            const char* payload = file.data + s.offset;
+
+            switch (s.type) {
+            case COOKED_POSITIONS:
+                positions = reinterpret_cast<const glm::vec3*>(payload);
+                positionCount = s.count;
+                break;
+            case COOKED_TEXCOORDS:
+                texcoords = reinterpret_cast<const glm::vec2*>(payload);
+                texcoordCount = s.count;
+                break;
+            case COOKED_NORMALS:
+                normals = reinterpret_cast<const glm::vec3*>(payload);
+                normalCount = s.count;
+                break;
+            case COOKED_INDICES:
+                indices = reinterpret_cast<const unsigned int*>(payload);
+                indexCount = s.count;
+                break;
+            case COOKED_MATERIAL:
+                if (s.count != 1)
+                    return false;
+                material = reinterpret_cast<const CookedMaterial*>(payload);
+                break;
+            case COOKED_BOUNDS:
+                if (s.count == 2)
+                    bounds = reinterpret_cast<const glm::vec3*>(payload);
+                break;
+            case COOKED_STRINGS: {
+                const char* p = payload;
+                const char* end = payload + s.count;
+                for (int k = 0; k < COOKED_STR_COUNT; k++) {
+                    uint32_t len;
+                    if (p + 4 > end)
+                        return false;
+                    std::memcpy(&len, p, 4);
+                    if (p + 4 + len > end)
+                        return false;
+                    strings[k].assign(p + 4, len);
+                    p += 4 + len;
+                }
+                break;
+            }
+            default:
+                break; // unknown sections are skipped
+            }
+        }
+        if (!positions || !indices || !material || !bounds)
+            return false;
+
+        // the indices go to GL and the CPU rasterizers unchecked
+        for (size_t i = 0; i < indexCount; i++)
+            if (indices[i] >= positionCount)
+                return false;
+        return true;
+    }
+};
+
+// Fill mesh from a valid cache for objPath. false = cache missing or stale.
+bool LoadCookedMesh(const std::string& objPath, Mesh& mesh)
+{
+    const std::string cachePath = CookedMeshPath(objPath);
+    CookedMesh cooked;
+    if (!cooked.open(cachePath))
+        return false;
+
+    CookedSourceStamp obj, mtl = cooked.header->mtl;
+    if (!StampStillValid(objPath, cooked.header->obj, &obj))
+        return false;
+    const std::string& mtlPath = cooked.strings[COOKED_STR_MTL_PATH];
+    if (!mtlPath.empty() && !StampStillValid(mtlPath, cooked.header->mtl, &mtl))
+        return false;
+    const bool refresh = obj.mtime != cooked.header->obj.mtime || mtl.mtime != cooked.header->mtl.mtime;
+
+    // bulk copies out of the mapping, nothing is parsed
+    mesh.positions.assign(cooked.positions, cooked.positions + cooked.positionCount);
+    mesh.texcoords.assign(cooked.texcoords, cooked.texcoords + cooked.texcoordCount);
+    mesh.normals.assign(cooked.normals, cooked.normals + cooked.normalCount);
+    mesh.indices.assign(cooked.indices, cooked.indices + cooked.indexCount);
+    mesh.vertexCount = cooked.positionCount;
+    mesh.boundsMin = cooked.bounds[0];
+    mesh.boundsMax = cooked.bounds[1];
+
+    mesh.materialLib = cooked.strings[COOKED_STR_MATERIAL_LIB];
+    mesh.activeMaterial = cooked.strings[COOKED_STR_ACTIVE_MATERIAL];
+
+    const CookedMaterial& m = *cooked.material;
+    mesh.material.name = cooked.strings[COOKED_STR_MATERIAL_NAME];
+    mesh.material.Ka = glm::vec3(m.Ka[0], m.Ka[1], m.Ka[2]);
+    mesh.material.Kd = glm::vec3(m.Kd[0], m.Kd[1], m.Kd[2]);
+    mesh.material.Ks = glm::vec3(m.Ks[0], m.Ks[1], m.Ks[2]);
+    mesh.material.Ns = m.Ns;
+    mesh.material.d = m.d;
+    mesh.material.illum = m.illum;
+    mesh.material.diffuseTexPath = cooked.strings[COOKED_STR_DIFFUSE_TEX];
+    mesh.material.normalMapPath = cooked.strings[COOKED_STR_NORMAL_MAP];
+    mesh.material.specularMapPath = cooked.strings[COOKED_STR_SPECULAR_MAP];
+
+    if (refresh) {
+        cooked.file.close();
+        if (!RefreshCookedStamp(cachePath, offsetof(CookedMeshHeader, obj), obj) ||
+            !RefreshCookedStamp(cachePath, offsetof(CookedMeshHeader, mtl), mtl))
+            std::cerr << "Could not refresh the mesh cache stamps of " << cachePath << "\n";
+    }
+    return true;
+}
+
+// Write the cache for a freshly parsed mesh. mtlPath is the .mtl the material
+// came from ("" if none). Written to a temp file and renamed into place.
+bool WriteCookedMesh(const std::string& objPath, const std::string& mtlPath, const Mesh& mesh)
+{
+    CookedMeshHeader header = {};
+    std::memcpy(header.magic, COOKED_MAGIC, 8);
+    header.version = COOKED_VERSION;
+    if (!StampFile(objPath, header.obj, true))
+        return false;
+    if (!mtlPath.empty() && !StampFile(mtlPath, header.mtl, true))
+        return false;
+
+    CookedMaterial material = {};
+    const Material& m = mesh.material;
+    for (int i = 0; i < 3; i++) {
+        material.Ka[i] = m.Ka[i];
+        material.Kd[i] = m.Kd[i];
+        material.Ks[i] = m.Ks[i];
+    }
+    material.Ns = m.Ns;
+    material.d = m.d;
+    material.illum = m.illum;
+
+    std::string strings;
+    const std::string* values[COOKED_STR_COUNT] = {
+        &mesh.materialLib, &mesh.activeMaterial, &mtlPath, &m.name,
+        &m.diffuseTexPath, &m.normalMapPath, &m.specularMapPath
+    };
+    for (const std::string* str : values) {
+        uint32_t len = static_cast<uint32_t>(str->size());
+        strings.append(reinterpret_cast<const char*>(&len), 4);
+        strings.append(*str);
+    }
+
+    const glm::vec3 bounds[2] = { mesh.boundsMin, mesh.boundsMax };
+
+    struct Payload { CookedSectionType type; uint32_t elementSize; const void* data; size_t count; };
+    const Payload payloads[] = {
+        { COOKED_POSITIONS, sizeof(glm::vec3), mesh.positions.data(), mesh.positions.size() },
+        { COOKED_TEXCOORDS, sizeof(glm::vec2), mesh.texcoords.data(), mesh.texcoords.size() },
+        { COOKED_NORMALS, sizeof(glm::vec3), mesh.normals.data(), mesh.normals.size() },
+        { COOKED_INDICES, sizeof(unsigned int), mesh.indices.data(), mesh.indices.size() },
+        { COOKED_MATERIAL, sizeof(CookedMaterial), &material, 1 },
+        { COOKED_STRINGS, 1, strings.data(), strings.size() },
+        { COOKED_BOUNDS, sizeof(glm::vec3), bounds, 2 },
+    };
+    const uint32_t sectionCount = sizeof(payloads) / sizeof(payloads[0]);
+
+    auto align = [](uint64_t offset) { return (offset + COOKED_ALIGNMENT - 1) & ~(COOKED_ALIGNMENT - 1); };
+
+    std::vector<CookedSection> sections(sectionCount);
+    uint64_t offset = align(sizeof(CookedMeshHeader) + sectionCount * sizeof(CookedSection));
+    for (uint32_t i = 0; i < sectionCount; i++) {
+        sections[i] = { payloads[i].type, payloads[i].elementSize, offset, payloads[i].count };
+        offset = align(offset + payloads[i].count * payloads[i].elementSize);
+    }
+    header.sectionCount = sectionCount;
+    header.fileSize = offset;
+
+    std::string cachePath = CookedMeshPath(objPath);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Cannot write mesh cache: " << tempPath << "\n";
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(sections.data()), sectionCount * sizeof(CookedSection));
+
+        static const char zeros[COOKED_ALIGNMENT] = {};
+        for (uint32_t i = 0; i < sectionCount; i++) {
+            uint64_t pos = static_cast<uint64_t>(out.tellp());
+            out.write(zeros, static_cast<std::streamsize>(sections[i].offset - pos));
+            out.write(static_cast<const char*>(payloads[i].data),
+                      static_cast<std::streamsize>(payloads[i].count * payloads[i].elementSize));
+        }
+        out.write(zeros, static_cast<std::streamsize>(header.fileSize - static_cast<uint64_t>(out.tellp())));
+        if (!out)
+            return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
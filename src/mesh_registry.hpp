@@ -0,0 +1,233 @@
+// GPU mesh registry
+//
+// Every unique mesh is uploaded once and shared by all GameObjects using it.
+// GameObjects only hold a MeshHandle; the registry counts references and frees
+// the VAO/buffers when the last one is released, together with its reference
+// to the diffuse texture in the TexturePool.
+//
+// With softwareTextures set the registry serves the software rasterizer
+// instead: meshes stay on the CPU, textures go to that pool and no GL call is
+// made, so it also works without a context. With vramTextures set as well the
+// textures go to the emulated VRAM instead of softwareTextures.
+//
+// CPU copies of positions / indices are only kept where something reads
+// them: always for software meshes, for GL meshes only with cpuGeometry set
+// (the software occlusion pass rasterizes occluders from them).
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.hpp"
+#include "vertex_format.hpp"
+#include "geometry_pool.hpp"
+#include "texture_pool.hpp"
+#include "software_texture.hpp"
+#include "gte_transform.hpp"
+#include "vram.hpp"
+
+// GPU side of one mesh
+struct GpuMesh {
+    std::string key;          // usually the source path
+    GLuint VAO = 0, VBO_vertices = 0, EBO = 0;
+    GLuint VBO_instances = 0;     // per instance model matrices (locations 3-6)
+    size_t instanceCapacity = 0;  // in matrices
+    GLsizei indexCount = 0;
+    VertexFormat format;
+    glm::mat4 decode = glm::mat4(1.0f); // quantized positions -> object space
+    bool quantized = false;             // decode != identity
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f); // object space AABB
+    GeometryRange pooled;     // copy in the shared GeometryPool, if there is one
+    TextureRef diffuse;       // (array, layer) in the TexturePool
+    GLuint diffuseTex = 0;    // GL name of that array, owned by the pool
+    glm::vec4 atlasRect = glm::vec4(0.0f); // Mesh::atlasRect
+    Material material;
+    unsigned int refCount = 0;
+
+    // CPU copy for the occlusion pass (MeshRegistry::cpuGeometry) and the software rasterizer
+    std::vector<glm::vec3> cpuPositions;
+    std::vector<unsigned int> cpuIndices;
+    // software rasterizer only
+    std::vector<glm::vec2> cpuTexcoords;
+    std::vector<glm::vec3> cpuNormals;
+    GteVertices gteVertices;      // cpuPositions * GTE_VERTEX_SCALE, for the GTE vertex stage
+    int32_t softwareTexture = -1; // in MeshRegistry::softwareTextures
+    int32_t vramTexture = -1;     // in MeshRegistry::vramTextures
+};
+
+struct MeshHandle {
+    uint32_t index = UINT32_MAX;
+
+    bool valid() const { return index != UINT32_MAX; }
+    bool operator==(const MeshHandle& other) const { return index == other.index; }
+    bool operator!=(const MeshHandle& other) const { return index != other.index; }
+};
+
+// Everything but the GL objects, positions / indices only with cpuGeometry
+void CopyMeshData(const Mesh& mesh, GpuMesh& gpu, bool cpuGeometry)
+{
+    gpu.indexCount = static_cast<GLsizei>(mesh.indices.size());
+    gpu.material = mesh.material;
+    gpu.atlasRect = mesh.atlasRect;
+    gpu.boundsMin = mesh.boundsMin;
+    gpu.boundsMax = mesh.boundsMax;
+    if (cpuGeometry) {
+        gpu.cpuPositions = mesh.positions;
+        gpu.cpuIndices = mesh.indices;
+    }
+}
+
+void UploadMesh(const Mesh& mesh, const VertexFormat& format, GpuMesh& gpu, GeometryPool* pool = nullptr,
+                bool cpuGeometry = false)
+{
+    // Create VAO and VBO for mesh
+    glGenVertexArrays(1, &gpu.VAO);
+    glGenBuffers(1, &gpu.VBO_vertices);
+    glGenBuffers(1, &gpu.EBO);
+
+    glBindVertexArray(gpu.VAO);
+
+    // --- Interleaved vertices ---
+    std::vector<uint8_t> vertices;
+    gpu.decode = PackVertices(mesh, format, vertices);
+    gpu.quantized = gpu.decode != glm::mat4(1.0f);
+    gpu.format = format;
+
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO_vertices);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+    ApplyVertexFormat(format);
+
+    // --- Per instance model matrix, filled by the InstanceBatcher ---
+    // a mat4 attribute takes 4 vec4 locations
+    glGenBuffers(1, &gpu.VBO_instances);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO_instances);
+    for (int col = 0; col < 4; col++) {
+        glVertexAttribPointer(3 + col, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(col * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + col);
+        glVertexAttribDivisor(3 + col, 1);
+    }
+
+    // --- Indices (bound to the VAO) ---
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 mesh.indices.size() * sizeof(unsigned int),
+                 mesh.indices.data(),
+                 GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+
+    // same packed vertices into the shared buffers (multi draw path)
+    if (pool)
+        gpu.pooled = pool->add(vertices, mesh.indices);
+
+    CopyMeshData(mesh, gpu, cpuGeometry);
+}
+
+void FreeMesh(GpuMesh& gpu, GeometryPool* pool = nullptr)
+{
+    if (pool)
+        pool->remove(gpu.pooled);
+    glDeleteVertexArrays(1, &gpu.VAO);
+    glDeleteBuffers(1, &gpu.VBO_vertices);
+    glDeleteBuffers(1, &gpu.EBO);
+    glDeleteBuffers(1, &gpu.VBO_instances);
+    gpu = GpuMesh{};
+}
+
+struct MeshRegistry {
+    std::vector<GpuMesh> meshes;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<std::string, uint32_t> byKey;
+    VertexFormat vertexFormat = DefaultVertexFormat(); // used for new uploads
+    GeometryPool* geometryPool = nullptr;              // optional, same vertexFormat
+    TexturePool* texturePool = nullptr;                // diffuse textures, none if not set
+    SoftwareTexturePool* softwareTextures = nullptr;   // set for the software rasterizer, no GL then
+    VramTexturePool* vramTextures = nullptr;           // optional with softwareTextures
+    std::string textureDir = "assets/";                // material paths are relative to it
+    bool cpuGeometry = false;                          // keep CPU positions / indices of GL meshes
+
+    // Reference the mesh registered under key, uploading it on first use
+    MeshHandle acquire(const std::string& key, const Mesh& mesh)
+    {
+        auto it = byKey.find(key);
+        if (it != byKey.end()) {
+            meshes[it->second].refCount++;
+            return MeshHandle{ it->second };
+        }
+
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            index = static_cast<uint32_t>(meshes.size());
+            meshes.emplace_back();
+        }
+
+        GpuMesh& gpu = meshes[index];
+        if (softwareTextures) {
+            CopyMeshData(mesh, gpu, true);
+            gpu.cpuTexcoords = mesh.texcoords;
+            gpu.cpuNormals = mesh.normals;
+            GteQuantizeVertices(mesh.positions, GTE_VERTEX_SCALE, gpu.gteVertices);
+            if (!mesh.material.diffuseTexPath.empty() && vramTextures)
+                gpu.vramTexture = vramTextures->acquire(textureDir + mesh.material.diffuseTexPath);
+            else if (!mesh.material.diffuseTexPath.empty())
+                gpu.softwareTexture = softwareTextures->acquire(textureDir + mesh.material.diffuseTexPath);
+        } else {
+            UploadMesh(mesh, vertexFormat, gpu, geometryPool, cpuGeometry);
+        }
+        if (!softwareTextures && texturePool && !mesh.material.diffuseTexPath.empty()) {
+            gpu.diffuse = texturePool->acquire(textureDir + mesh.material.diffuseTexPath);
+            gpu.diffuseTex = texturePool->texture(gpu.diffuse);
+        }
+        gpu.key = key;
+        gpu.refCount = 1;
+        byKey[key] = index;
+        return MeshHandle{ index };
+    }
+
+    // Add a reference to an already registered mesh
+    MeshHandle acquire(MeshHandle handle)
+    {
+        if (handle.valid())
+            meshes[handle.index].refCount++;
+        return handle;
+    }
+
+    // Drop a reference, the GPU resources go away with the last one
+    void release(MeshHandle& handle)
+    {
+        if (!handle.valid())
+            return;
+
+        GpuMesh& gpu = meshes[handle.index];
+        if (gpu.refCount == 0) {
+            std::cerr << "MeshRegistry: release of unreferenced mesh " << handle.index << "\n";
+        } else if (--gpu.refCount == 0) {
+            byKey.erase(gpu.key);
+            if (softwareTextures) {
+                softwareTextures->release(gpu.softwareTexture);
+                if (vramTextures)
+                    vramTextures->release(gpu.vramTexture);
+                gpu = GpuMesh{};
+                freeSlots.push_back(handle.index);
+                handle = MeshHandle{};
+                return;
+            }
+            if (texturePool)
+                texturePool->release(gpu.diffuse);
+            FreeMesh(gpu, geometryPool);
+            freeSlots.push_back(handle.index);
+        }
+        handle = MeshHandle{};
+    }
+
+    const GpuMesh& get(MeshHandle handle) const { return meshes[handle.index]; }
+    GpuMesh& get(MeshHandle handle) { return meshes[handle.index]; }
+
+    size_t liveCount() const { return byKey.size(); }
+};
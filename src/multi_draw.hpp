@@ -0,0 +1,198 @@
+// Multi draw indirect over the shared GeometryPool
+//
+// The visible set becomes one DrawElementsIndirectCommand and one DrawData
+// entry (model matrix, params) per object. With GL 4.3 every batch of draws
+// sharing a texture array is one glMultiDrawElementsIndirect and DrawData is read
+// from an SSBO; on 3.3 the same commands are issued as a loop of
+// glDrawElementsBaseVertex and DrawData is read through a texture buffer.
+//
+// The shader finds its DrawData through the aDrawIndex attribute: a static
+// 0..n-1 buffer with divisor 1, offset per command by baseInstance (gl_DrawID
+// would need GL 4.6). The fallback loop sets it as a constant attribute.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "geometry_pool.hpp"
+#include "mesh_registry.hpp"
+#include "shader_program.hpp"
+
+const GLuint ATTRIB_DRAW_INDEX = 8;
+const GLuint DRAW_DATA_SSBO_BINDING = 1;
+const GLint DRAW_DATA_TEXTURE_UNIT = 1;
+
+// Layout of the GL indirect command
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance; // = draw index
+};
+
+// std430 DrawData in the shader, 6 vec4 per draw for the texture buffer path
+struct DrawData {
+    glm::mat4 model;     // includes the decode matrix
+    glm::vec4 params;    // x: alpha, y: texture array layer, z: CLUT row (-1 none), w: unused
+    glm::vec4 atlasRect; // GpuMesh::atlasRect
+};
+
+struct MultiDrawRenderer {
+    bool indirect = false; // GL 4.3: MDI + SSBO
+    ShaderProgram program;
+    GLuint VAO = 0;        // the GeometryPool VAO
+    GLuint commandBuffer = 0, drawDataBuffer = 0, drawDataTexture = 0, drawIndexBuffer = 0;
+    size_t capacity = 0;   // draws the buffers hold
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<DrawData> drawData;
+
+    // Shader sources come without #version, the path decides it
+    bool create(bool indirect, GeometryPool& pool, const std::string& vertexSrc, const std::string& fragmentSrc)
+    {
+        this->indirect = indirect;
+        VAO = pool.VAO;
+
+        std::string header = indirect ? "#version 430 core\n#define DRAW_DATA_SSBO\n" : "#version 330 core\n";
+        std::string vs = header + vertexSrc, fs = header + fragmentSrc;
+        if (!program.build(vs.c_str(), fs.c_str()))
+            return false;
+
+        glUseProgram(program.id);
+        glUniform1i(program.location("diffuseTex"), 0);
+        glUniform1i(program.location("clutTex"), CLUT_TEXTURE_UNIT);
+        if (!indirect)
+            glUniform1i(program.location("drawDataTex"), DRAW_DATA_TEXTURE_UNIT);
+        glUseProgram(0);
+
+        glGenBuffers(1, &commandBuffer);
+        glGenBuffers(1, &drawDataBuffer);
+        glGenBuffers(1, &drawIndexBuffer);
+        if (!indirect)
+            glGenTextures(1, &drawDataTexture);
+
+        reserve(1024);
+        return true;
+    }
+
+    void destroy()
+    {
+        program.destroy();
+        glDeleteBuffers(1, &commandBuffer);
+        glDeleteBuffers(1, &drawDataBuffer);
+        glDeleteBuffers(1, &drawIndexBuffer);
+        if (drawDataTexture)
+            glDeleteTextures(1, &drawDataTexture);
+        commandBuffer = drawDataBuffer = drawIndexBuffer = drawDataTexture = 0;
+        capacity = 0;
+    }
+
+    // Grow the per draw buffers, the 0..n-1 draw index buffer is static
+    void reserve(size_t draws)
+    {
+        if (draws <= capacity)
+            return;
+        capacity = std::max(draws, capacity + capacity / 2);
+
+        std::vector<GLuint> drawIndices(capacity);
+        for (size_t i = 0; i < capacity; i++)
+            drawIndices[i] = static_cast<GLuint>(i);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+        glVertexAttribIPointer(ATTRIB_DRAW_INDEX, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(ATTRIB_DRAW_INDEX, 1);
+        // without baseInstance the index is a constant attribute set per draw
+        if (indirect)
+            glEnableVertexAttribArray(ATTRIB_DRAW_INDEX);
+        else
+            glDisableVertexAttribArray(ATTRIB_DRAW_INDEX);
+        glBindVertexArray(0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, drawDataBuffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(DrawData), nullptr, GL_STREAM_DRAW);
+        if (indirect) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        } else {
+            glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawDataBuffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+    }
+
+    void begin()
+    {
+        commands.clear();
+        drawData.clear();
+    }
+
+    // Returns the draw index
+    uint32_t add(const GpuMesh& gpu, const glm::mat4& model)
+    {
+        uint32_t index = static_cast<uint32_t>(commands.size());
+        DrawElementsIndirectCommand cmd;
+        cmd.count = gpu.pooled.indexCount;
+        cmd.instanceCount = 1;
+        cmd.firstIndex = gpu.pooled.firstIndex;
+        cmd.baseVertex = static_cast<GLint>(gpu.pooled.baseVertex);
+        cmd.baseInstance = index;
+        commands.push_back(cmd);
+
+        DrawData data;
+        data.model = gpu.quantized ? model * gpu.decode : model;
+        data.params = glm::vec4(gpu.material.d, gpu.diffuse.layer, gpu.diffuse.clut, 0.0f);
+        data.atlasRect = gpu.atlasRect;
+        drawData.push_back(data);
+        return index;
+    }
+
+    // Upload all draws of the frame, binds program, VAO and per draw data
+    void upload()
+    {
+        reserve(commands.size());
+
+        // orphan + refill
+        glBindBuffer(GL_ARRAY_BUFFER, drawDataBuffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(DrawData), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, drawData.size() * sizeof(DrawData), drawData.data());
+
+        glUseProgram(program.id);
+        glBindVertexArray(VAO);
+        if (indirect) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_SSBO_BINDING, drawDataBuffer);
+        } else {
+            glActiveTexture(GL_TEXTURE0 + DRAW_DATA_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+    }
+
+    // Draw commands [first, first + count), returns the GL draw calls issued
+    size_t draw(size_t first, size_t count)
+    {
+        if (indirect) {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                        (void*)(first * sizeof(DrawElementsIndirectCommand)),
+                                        static_cast<GLsizei>(count), 0);
+            return 1;
+        }
+
+        for (size_t i = first; i < first + count; i++) {
+            const DrawElementsIndirectCommand& cmd = commands[i];
+            glVertexAttribI1ui(ATTRIB_DRAW_INDEX, cmd.baseInstance);
+            glDrawElementsBaseVertex(GL_TRIANGLES, cmd.count, GL_UNSIGNED_INT,
+                                     (void*)(cmd.firstIndex * sizeof(unsigned int)), cmd.baseVertex);
+        }
+        return count;
+    }
+};
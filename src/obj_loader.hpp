@@ -6,10 +6,23 @@
 #include <algorithm>
 
 #include <unordered_map>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <thread>
 #include <glm/glm.hpp> 
 
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include "mesh_cache.hpp"
+
+// the one stb_image implementation; undefined again so the texture headers
+// including stb_image.h after this only get the declarations
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+
+#include "texture_atlas.hpp"
 
 // vec3 printing
 std::ostream& operator<<(std::ostream& os, const glm::vec3& v)
@@ -25,51 +38,11 @@ std::ostream& operator<<(std::ostream& os, const glm::vec2& v)
     return os;
 }
 
-struct Material {
-    std::string name;
-
-    glm::vec3 Ka = glm::vec3(0.0f);  // Ambient col
-    glm::vec3 Kd = glm::vec3(1.0f);  // Diffuse col
-    glm::vec3 Ks = glm::vec3(0.0f);  // Specular col
-    float Ns = 0.0f;                 // Shine
-    float d = 1.0f;                  // Transparency
-    int illum = 2;                   // illum model
-
-    std::string diffuseTexPath;
-    std::string normalMapPath;
-    std::string specularMapPath;
-
-    //unsigned int diffuseTexID = 0;
-    //unsigned int normalMapID = 0;
-    //unsigned int specularTexID = 0;
-};
-
-// Mesh with associated material and texture
-struct Mesh {
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec2> texcoords;
-    std::vector<glm::vec3> normals;
-    std::vector<unsigned int> indices;
-    
-    std::string materialLib;    // Path to .mtl
-    std::string activeMaterial; // active material
-    
-    Material material;
-    
-    // OpenGL texture
-    GLuint diffuseTex = 0;   
-    GLuint specularTex = 0;
-    GLuint normalTex = 0;
-    
-    // Rendering props
-    GLuint VAO, VBO_positions, VBO_texcoords;
-    size_t vertexCount;
-    glm::mat4 model; //model matrix
-    
-};
-
-// Load a simple OBJ file (no materials)
-Mesh LoadOBJ(const std::string path);
+// Load a simple OBJ file (no materials), threadCount 0 = one per core. With an
+// atlas the diffuse texture is packed into it and the texcoords remapped.
+Mesh LoadOBJ(const std::string path, unsigned int threadCount = 0, TextureAtlas* atlas = nullptr);
+// Parse OBJ text already in memory (LoadOBJ without material / texture loading)
+void ParseOBJ(const char* data, size_t size, Mesh& mesh, unsigned int threadCount = 1);
 // Load mtl file
 std::vector<Material> LoadMTL(const std::string& path);
 
@@ -173,134 +146,450 @@ GLuint LoadTextureFromFile(const std::string& baseDir, const std::string& fileNa
     return textureID;
 }
 
-Mesh LoadOBJ(const std::string path)
+// --- in-place OBJ tokenizing ---
+// The parser walks the mapped file with raw pointers, a line is [p, lineEnd)
+// and nothing is copied out of it except the mtllib/usemtl names.
+
+static inline bool objIsSpace(char c)
 {
-    Mesh mesh;
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
 
-    // Temporary storage for data before faces are processed
-    std::vector<glm::vec3> temp_positions;
-    std::vector<glm::vec2> temp_texcoords;
-    std::vector<glm::vec3> temp_normals;
+static inline const char* objSkipSpace(const char* p, const char* end)
+{
+    while (p < end && objIsSpace(*p))
+        ++p;
+    return p;
+}
 
-    std::ifstream file(path);
-    if (!file) {
-        std::cerr << "Error: Cannot open OBJ file: " << path << "\n";
-        return mesh;
+static inline const char* objTokenEnd(const char* p, const char* end)
+{
+    while (p < end && !objIsSpace(*p))
+        ++p;
+    return p;
+}
+
+static inline bool objTokenIs(const char* p, const char* tokEnd, const char* cmd)
+{
+    size_t len = std::strlen(cmd);
+    return static_cast<size_t>(tokEnd - p) == len && std::memcmp(p, cmd, len) == 0;
+}
+
+// Parse next whitespace separated float, malformed tokens give 0 like a failed stream read
+static inline const char* objParseFloat(const char* p, const char* end, float& out)
+{
+    p = objSkipSpace(p, end);
+    const char* tokEnd = objTokenEnd(p, end);
+    const char* first = (p < tokEnd && *p == '+') ? p + 1 : p;
+
+    out = 0.0f;
+    std::from_chars(first, tokEnd, out);
+    return tokEnd;
+}
+
+// Parse a face index at p, 0 if there is none (missing vt in "1//3" etc.)
+static inline const char* objParseIndex(const char* p, const char* end, unsigned int& out)
+{
+    const char* first = (p < end && *p == '+') ? p + 1 : p;
+    int value = 0;
+    auto result = std::from_chars(first, end, value);
+    if (result.ec != std::errc()) {
+        out = 0;
+        return p;
     }
+    // negative (relative) indices end up out of range and get dropped, same as before
+    out = static_cast<unsigned int>(value);
+    return result.ptr;
+}
 
-    std::string line;
-    
-    
-    while (std::getline(file, line))
+// Parse one "v", "v/t", "v/t/n" or "v//n" face corner in [p, tokEnd)
+static inline void objParseCorner(const char* p, const char* tokEnd,
+                                  unsigned int& vi, unsigned int& ti, unsigned int& ni)
+{
+    vi = ti = ni = 0;
+    objParseIndex(p, tokEnd, vi);
+
+    const char* firstSlash = static_cast<const char*>(std::memchr(p, '/', tokEnd - p));
+    if (!firstSlash)
+        return;
+    objParseIndex(firstSlash + 1, tokEnd, ti);
+
+    const char* secondSlash = static_cast<const char*>(std::memchr(firstSlash + 1, '/', tokEnd - firstSlash - 1));
+    if (!secondSlash)
+        return;
+    objParseIndex(secondSlash + 1, tokEnd, ni);
+}
+
+// --- vertex welding ---
+// Every face corner is a (v, vt, vn) triplet; identical triplets share one vertex
+// so mesh.indices is a real index buffer instead of 0..N-1.
+
+struct ObjCorner {
+    unsigned int v = 0, t = 0, n = 0; // 1-based, 0 = missing
+};
+
+// Open addressing hash table (linear probing) from triplet to vertex index
+struct VertexWeldTable {
+    std::vector<ObjCorner> keys;
+    std::vector<unsigned int> values;
+    size_t count = 0;
+    size_t mask = 0;
+
+    static size_t hash(const ObjCorner& c)
     {
-        
-        
-        size_t comment_pos = line.find('#');
-        if (comment_pos != std::string::npos)
-            line = line.substr(0, comment_pos);
+        uint64_t h = c.v * 0x9E3779B97F4A7C15ull;
+        h ^= (c.t + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+        h ^= (c.n + 0x165667B19E3779F9ull) * 0x94D049BB133111EBull;
+        return static_cast<size_t>(h ^ (h >> 31));
+    }
 
-        auto is_not_space = [](unsigned char c) { return !std::isspace(c); };
-        line.erase(line.begin(), std::find_if(line.begin(), line.end(), is_not_space));
-        line.erase(std::find_if(line.rbegin(), line.rend(), is_not_space).base(), line.end());
+    void grow()
+    {
+        std::vector<ObjCorner> oldKeys = std::move(keys);
+        std::vector<unsigned int> oldValues = std::move(values);
+
+        size_t capacity = oldKeys.empty() ? 1024 : oldKeys.size() * 2;
+        keys.assign(capacity, ObjCorner{});
+        values.assign(capacity, 0);
+        mask = capacity - 1;
+
+        // v == 0 marks an empty slot, corners without position are stored with v = ~0
+        for (size_t i = 0; i < oldKeys.size(); i++) {
+            if (oldKeys[i].v == 0)
+                continue;
+            size_t slot = hash(oldKeys[i]) & mask;
+            while (keys[slot].v != 0)
+                slot = (slot + 1) & mask;
+            keys[slot] = oldKeys[i];
+            values[slot] = oldValues[i];
+        }
+    }
+
+    // Returns the index for c, inserting nextIndex if c is new
+    unsigned int insert(ObjCorner c, unsigned int nextIndex, bool& inserted)
+    {
+        if (c.v == 0)
+            c.v = ~0u;
+        if ((count + 1) * 2 > keys.size())
+            grow();
+
+        size_t slot = hash(c) & mask;
+        while (keys[slot].v != 0) {
+            const ObjCorner& k = keys[slot];
+            if (k.v == c.v && k.t == c.t && k.n == c.n) {
+                inserted = false;
+                return values[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        keys[slot] = c;
+        values[slot] = nextIndex;
+        count++;
+        inserted = true;
+        return nextIndex;
+    }
+};
+
+// Fill the vertex arrays for the welded vertices. texcoords / normals are only
+// written if any corner references them, and then for every vertex so the
+// arrays stay aligned with positions.
+void BuildWeldedVertices(const std::vector<ObjCorner>& corners,
+                         const std::vector<glm::vec3>& positions,
+                         const std::vector<glm::vec2>& texcoords,
+                         const std::vector<glm::vec3>& normals,
+                         Mesh& mesh)
+{
+    bool hasTexcoords = false, hasNormals = false;
+    for (const ObjCorner& c : corners) {
+        hasTexcoords |= c.t != 0;
+        hasNormals |= c.n != 0;
+    }
+
+    mesh.positions.resize(corners.size());
+    if (hasTexcoords)
+        mesh.texcoords.resize(corners.size());
+    if (hasNormals)
+        mesh.normals.resize(corners.size());
+
+    for (size_t i = 0; i < corners.size(); i++) {
+        const ObjCorner& c = corners[i];
+        mesh.positions[i] = c.v ? positions[c.v - 1] : glm::vec3(0.0f);
+        if (hasTexcoords)
+            mesh.texcoords[i] = c.t ? texcoords[c.t - 1] : glm::vec2(0.0f);
+        if (hasNormals)
+            mesh.normals[i] = c.n ? normals[c.n - 1] : glm::vec3(0.0f);
+    }
+    mesh.vertexCount = corners.size();
+    ComputeMeshBounds(mesh);
+}
+
+// --- chunked parsing ---
+// The file is split at line boundaries into chunks that are parsed independently
+// (one per worker thread). Face indices in OBJ are global, so a chunk keeps them
+// raw and they are validated after the prefix sums over the per-chunk v/vt/vn
+// counts are known. The serial loader is the same code with a single chunk.
+
+// Local v/vt/vn counts in effect from corner `firstCorner` on
+struct ObjCountSnapshot {
+    size_t firstCorner;
+    unsigned int positions, texcoords, normals;
+};
+
+struct ObjChunk {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texcoords;
+    std::vector<glm::vec3> normals;
+    std::vector<ObjCorner> corners;
+    std::vector<ObjCountSnapshot> snapshots;
+
+    bool hasMaterialLib = false, hasActiveMaterial = false;
+    std::string materialLib, activeMaterial; // last seen in this chunk
+
+    // global offsets of this chunk (prefix sums)
+    unsigned int positionBase = 0, texcoordBase = 0, normalBase = 0;
+};
+
+void ParseOBJChunk(const char* begin, const char* end, ObjChunk& chunk)
+{
+    const char* p = begin;
+
+    while (p < end)
+    {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!lineEnd)
+            lineEnd = end;
+        const char* next = (lineEnd < end) ? lineEnd + 1 : end;
+
+        // Strip comments
+        const char* comment = static_cast<const char*>(std::memchr(p, '#', lineEnd - p));
+        if (comment)
+            lineEnd = comment;
 
         // Skip empty or comment-only lines
-        if (line.empty())
+        p = objSkipSpace(p, lineEnd);
+        if (p == lineEnd) {
+            p = next;
             continue;
+        }
 
-        std::istringstream ss(line);
-        std::string cmd;
-        ss >> cmd;
+        const char* cmdEnd = objTokenEnd(p, lineEnd);
 
-        if (cmd == "v") {
+        if (objTokenIs(p, cmdEnd, "v")) {
             glm::vec3 v;
-            ss >> v.x >> v.y >> v.z;
-            temp_positions.push_back(v);
+            const char* q = objParseFloat(cmdEnd, lineEnd, v.x);
+            q = objParseFloat(q, lineEnd, v.y);
+            objParseFloat(q, lineEnd, v.z);
+            chunk.positions.push_back(v);
         }
-        else if (cmd == "vt") {
+        else if (objTokenIs(p, cmdEnd, "vt")) {
             glm::vec2 vt;
-            ss >> vt.x >> vt.y;
-            temp_texcoords.push_back(vt);
+            const char* q = objParseFloat(cmdEnd, lineEnd, vt.x);
+            objParseFloat(q, lineEnd, vt.y);
+            chunk.texcoords.push_back(vt);
         }
-        else if (cmd == "vn") {
+        else if (objTokenIs(p, cmdEnd, "vn")) {
             glm::vec3 vn;
-            ss >> vn.x >> vn.y >> vn.z;
-            temp_normals.push_back(vn);
+            const char* q = objParseFloat(cmdEnd, lineEnd, vn.x);
+            q = objParseFloat(q, lineEnd, vn.y);
+            objParseFloat(q, lineEnd, vn.z);
+            chunk.normals.push_back(vn);
         }
-        else if (cmd == "mtllib") {
-            ss >> mesh.materialLib;
+        else if (objTokenIs(p, cmdEnd, "mtllib")) {
+            const char* name = objSkipSpace(cmdEnd, lineEnd);
+            chunk.materialLib.assign(name, objTokenEnd(name, lineEnd));
+            chunk.hasMaterialLib = true;
         }
-        else if (cmd == "usemtl") {
-            ss >> mesh.activeMaterial;
+        else if (objTokenIs(p, cmdEnd, "usemtl")) {
+            const char* name = objSkipSpace(cmdEnd, lineEnd);
+            chunk.activeMaterial.assign(name, objTokenEnd(name, lineEnd));
+            chunk.hasActiveMaterial = true;
         }
-        else if (cmd == "f") {
-            std::string vertex_str;
-            while (ss >> vertex_str) {
-                unsigned int vi = 0, ti = 0, ni = 0;
-
-                size_t firstSlash = vertex_str.find('/');
-                size_t secondSlash = vertex_str.find('/', firstSlash + 1);
-
-                if (firstSlash == std::string::npos) {
-                    // format: f v
-                    vi = std::stoi(vertex_str);
-                } else if (secondSlash == std::string::npos) {
-                    // format: f v/t
-                    vi = std::stoi(vertex_str.substr(0, firstSlash));
-                    ti = std::stoi(vertex_str.substr(firstSlash + 1));
-                } else {
-                    // format: f v/t/n or f v//n
-                    vi = std::stoi(vertex_str.substr(0, firstSlash));
-                    if (secondSlash > firstSlash + 1)
-                        ti = std::stoi(vertex_str.substr(firstSlash + 1, secondSlash - firstSlash - 1));
-                    if (secondSlash + 1 < vertex_str.size())
-                        ni = std::stoi(vertex_str.substr(secondSlash + 1));
-                }
-
-                if (vi > 0 && vi <= temp_positions.size())
-                    mesh.positions.push_back(temp_positions[vi - 1]);
-                if (ti > 0 && ti <= temp_texcoords.size())
-                    mesh.texcoords.push_back(temp_texcoords[ti - 1]);
-                if (ni > 0 && ni <= temp_normals.size())
-                    mesh.normals.push_back(temp_normals[ni - 1]);
-
-                mesh.indices.push_back(static_cast<unsigned int>(mesh.indices.size()));
+        else if (objTokenIs(p, cmdEnd, "f")) {
+            // Remember the local counts whenever they changed since the last face
+            unsigned int np = static_cast<unsigned int>(chunk.positions.size());
+            unsigned int nt = static_cast<unsigned int>(chunk.texcoords.size());
+            unsigned int nn = static_cast<unsigned int>(chunk.normals.size());
+            if (chunk.snapshots.empty() || chunk.snapshots.back().positions != np ||
+                chunk.snapshots.back().texcoords != nt || chunk.snapshots.back().normals != nn)
+                chunk.snapshots.push_back({ chunk.corners.size(), np, nt, nn });
+
+            const char* q = cmdEnd;
+            while (true) {
+                q = objSkipSpace(q, lineEnd);
+                if (q == lineEnd)
+                    break;
+                const char* tokEnd = objTokenEnd(q, lineEnd);
+
+                ObjCorner c;
+                objParseCorner(q, tokEnd, c.v, c.t, c.n);
+                chunk.corners.push_back(c);
+                q = tokEnd;
             }
         }
+
+        p = next;
     }
-    
-    // Add material to mesh
-    if (!mesh.materialLib.empty()) {
-        std::string mtlPath = "assets/" + mesh.materialLib;
-        auto materials = LoadMTL(mtlPath);
-        
-        for (auto& mat : materials) {
-            if (mat.name == mesh.activeMaterial) {
-                mesh.material = mat; 
-                break;
-            }
+}
+
+// Zero every corner index that was out of range at the point it appeared in the file
+void ValidateOBJChunk(ObjChunk& chunk)
+{
+    for (size_t s = 0; s < chunk.snapshots.size(); s++) {
+        const ObjCountSnapshot& snap = chunk.snapshots[s];
+        size_t last = (s + 1 < chunk.snapshots.size()) ? chunk.snapshots[s + 1].firstCorner : chunk.corners.size();
+
+        unsigned int maxV = chunk.positionBase + snap.positions;
+        unsigned int maxT = chunk.texcoordBase + snap.texcoords;
+        unsigned int maxN = chunk.normalBase + snap.normals;
+
+        for (size_t i = snap.firstCorner; i < last; i++) {
+            ObjCorner& c = chunk.corners[i];
+            if (c.v > maxV) c.v = 0;
+            if (c.t > maxT) c.t = 0;
+            if (c.n > maxN) c.n = 0;
         }
-        
-    // Load diffuse texture from file
-    // using mesh.material.diffuseTexPath;
-    /* load an image file directly as a new OpenGL texture */
-    
-    std::cout << mesh.material.diffuseTexPath << "\n";
-    mesh.diffuseTex = LoadTextureFromFile("assets/", mesh.material.diffuseTexPath);
-        
-    /* check for an error during the load process */ 
-    if (mesh.diffuseTex == 0) {
-        std::cerr << "Failed to load diffuse texture!\n";
+    }
+}
+
+void ParseOBJ(const char* data, size_t size, Mesh& mesh, unsigned int threadCount)
+{
+    if (threadCount == 0)
+        threadCount = 1;
+
+    // Split at newline boundaries, a chunk never starts mid-line
+    std::vector<const char*> bounds;
+    bounds.push_back(data);
+    for (unsigned int i = 1; i < threadCount; i++) {
+        const char* cut = data + size * i / threadCount;
+        if (cut < bounds.back())
+            cut = bounds.back();
+        const char* nl = static_cast<const char*>(std::memchr(cut, '\n', data + size - cut));
+        bounds.push_back(nl ? nl + 1 : data + size);
+    }
+    bounds.push_back(data + size);
+
+    std::vector<ObjChunk> chunks(threadCount);
+    auto parse = [&](unsigned int i) { ParseOBJChunk(bounds[i], bounds[i + 1], chunks[i]); };
+
+    if (threadCount == 1) {
+        parse(0);
     } else {
-        std::cout << "Diffuse texture loaded successfully, ID: " << mesh.diffuseTex << "\n";
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.emplace_back(parse, i);
+        parse(0);
+        for (auto& w : workers)
+            w.join();
     }
-    
-    if (glIsTexture(mesh.diffuseTex)) {
-        std::cout << "Diffuse texture is valid!\n";
+
+    // Prefix sums over the per-chunk counts
+    unsigned int totalPositions = 0, totalTexcoords = 0, totalNormals = 0;
+    size_t totalCorners = 0;
+    for (ObjChunk& chunk : chunks) {
+        chunk.positionBase = totalPositions;
+        chunk.texcoordBase = totalTexcoords;
+        chunk.normalBase = totalNormals;
+        totalPositions += static_cast<unsigned int>(chunk.positions.size());
+        totalTexcoords += static_cast<unsigned int>(chunk.texcoords.size());
+        totalNormals += static_cast<unsigned int>(chunk.normals.size());
+        totalCorners += chunk.corners.size();
+
+        // last mtllib / usemtl in the file wins
+        if (chunk.hasMaterialLib)
+            mesh.materialLib = chunk.materialLib;
+        if (chunk.hasActiveMaterial)
+            mesh.activeMaterial = chunk.activeMaterial;
+    }
+
+    // Fix up indices and gather the vertex data at the chunk offsets
+    std::vector<glm::vec3> temp_positions(totalPositions);
+    std::vector<glm::vec2> temp_texcoords(totalTexcoords);
+    std::vector<glm::vec3> temp_normals(totalNormals);
+
+    auto merge = [&](unsigned int i) {
+        ObjChunk& chunk = chunks[i];
+        ValidateOBJChunk(chunk);
+        std::copy(chunk.positions.begin(), chunk.positions.end(), temp_positions.begin() + chunk.positionBase);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), temp_texcoords.begin() + chunk.texcoordBase);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), temp_normals.begin() + chunk.normalBase);
+    };
+
+    if (threadCount == 1) {
+        merge(0);
     } else {
-        std::cerr << "Diffuse texture is not valid!\n";
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.emplace_back(merge, i);
+        merge(0);
+        for (auto& w : workers)
+            w.join();
     }
-    
+
+    // Welding stays serial, the vertex order is the order of first use in the file
+    VertexWeldTable weld;
+    std::vector<ObjCorner> uniqueCorners;
+    mesh.indices.reserve(totalCorners);
+
+    for (const ObjChunk& chunk : chunks) {
+        for (const ObjCorner& c : chunk.corners) {
+            bool inserted;
+            unsigned int index = weld.insert(c, static_cast<unsigned int>(uniqueCorners.size()), inserted);
+            if (inserted)
+                uniqueCorners.push_back(c);
+            mesh.indices.push_back(index);
+        }
     }
+
+    BuildWeldedVertices(uniqueCorners, temp_positions, temp_texcoords, temp_normals, mesh);
+}
+
+// Files below this size are not worth spinning up threads for
+const size_t OBJ_PARALLEL_MIN_BYTES = 1 << 20;
+
+Mesh LoadOBJ(const std::string path, unsigned int threadCount, TextureAtlas* atlas)
+{
+    Mesh mesh;
+
+    // Geometry + material straight from the cooked cache if it is still valid
+    if (!LoadCookedMesh(path, mesh)) {
+        MappedFile file;
+        if (!file.open(path)) {
+            std::cerr << "Error: Cannot open OBJ file: " << path << "\n";
+            return mesh;
+        }
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        if (file.size < OBJ_PARALLEL_MIN_BYTES)
+            threadCount = 1;
+
+        ParseOBJ(file.data, file.size, mesh, threadCount);
+        file.close();
+
+        // Add material to mesh
+        std::string mtlPath;
+        if (!mesh.materialLib.empty()) {
+            mtlPath = "assets/" + mesh.materialLib;
+            auto materials = LoadMTL(mtlPath);
+
+            for (auto& mat : materials) {
+                if (mat.name == mesh.activeMaterial) {
+                    mesh.material = mat;
+                    break;
+                }
+            }
+        }
+
+        if (!WriteCookedMesh(path, mtlPath, mesh))
+            std::cerr << "Could not cook mesh cache for " << path << "\n";
+    }
+
+    // The cooked cache keeps the original texcoords, the atlas layout may change
+    if (atlas)
+        atlas->remap(mesh);
+
+    // The diffuse texture (mesh.material.diffuseTexPath) is loaded into the
+    // TexturePool when the mesh is registered, LoadOBJ does no GL work.
+    
     /*
     std::cout << "Loaded OBJ: " << path << "\n";
     std::cout << "  Vertices #: " << mesh.positions.size() << "\n";
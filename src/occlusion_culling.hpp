@@ -0,0 +1,287 @@
+// Software occlusion culling
+//
+// Occluders (GameObject::occluder) among the frustum survivors are rasterized
+// depth only into a small buffer, one horizontal band per ThreadPool job, with
+// SSE edge functions 4 pixels at a time. Each band then writes its part of a
+// hierarchical Z level that keeps the farthest depth of every 8x8 block.
+//
+// A candidate is hidden when the nearest depth of its projected world AABB is
+// behind every block its screen rectangle touches. Boxes crossing the near
+// plane are always kept, occluder triangles crossing it are dropped; both only
+// make the test more conservative.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "thread_pool.hpp"
+#include "spatial_index.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define OCCLUSION_SSE 1
+#endif
+
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 128;
+const int OCCLUSION_BLOCK = 8;  // HiZ block size in pixels
+const int OCCLUSION_BLOCKS_X = OCCLUSION_WIDTH / OCCLUSION_BLOCK;
+const int OCCLUSION_BLOCKS_Y = OCCLUSION_HEIGHT / OCCLUSION_BLOCK;
+const int OCCLUSION_BAND_ROWS = 16; // rows per raster job, multiple of OCCLUSION_BLOCK
+const int OCCLUSION_BANDS = OCCLUSION_HEIGHT / OCCLUSION_BAND_ROWS;
+
+// Screen space triangle, pixel centers at +0.5, row 0 at the bottom
+struct OcclusionTriangle {
+    float x[3], y[3], z[3]; // z as 0..1 window depth
+    int minX, maxX, minY, maxY;
+};
+
+struct OcclusionStats {
+    size_t occluders = 0, triangles = 0; // rasterized this frame
+    size_t tested = 0, occluded = 0;
+    double rasterMs = 0.0, testMs = 0.0;
+
+    void print() const
+    {
+        std::cout << "Occlusion: " << occluded << " of " << tested << " tested objects hidden by "
+                  << occluders << " occluders (" << triangles << " triangles), raster "
+                  << rasterMs << " ms, test " << testMs << " ms\n";
+    }
+};
+
+// Rasterize the rows [rowBegin, rowEnd] of a counter clockwise triangle
+void RasterizeOcclusionTriangle(const OcclusionTriangle& tri, int rowBegin, int rowEnd, float* depth)
+{
+    // edge i is opposite vertex i, E(p) = A*px + B*py + C >= 0 inside
+    float A[3], B[3], C[3];
+    for (int i = 0; i < 3; i++) {
+        int a = (i + 1) % 3, b = (i + 2) % 3;
+        A[i] = -(tri.y[b] - tri.y[a]);
+        B[i] = tri.x[b] - tri.x[a];
+        C[i] = -(A[i] * tri.x[a] + B[i] * tri.y[a]);
+    }
+
+    // depth plane from the barycentric weights E_i / area
+    float invArea = 1.0f / (A[0] * tri.x[0] + B[0] * tri.y[0] + C[0]);
+    float zA = (A[0] * tri.z[0] + A[1] * tri.z[1] + A[2] * tri.z[2]) * invArea;
+    float zB = (B[0] * tri.z[0] + B[1] * tri.z[1] + B[2] * tri.z[2]) * invArea;
+    float zC = (C[0] * tri.z[0] + C[1] * tri.z[1] + C[2] * tri.z[2]) * invArea;
+
+    const int xBegin = tri.minX & ~3;
+
+#if defined(OCCLUSION_SSE)
+    const __m128 a0 = _mm_set1_ps(A[0]), a1 = _mm_set1_ps(A[1]), a2 = _mm_set1_ps(A[2]);
+    const __m128 za = _mm_set1_ps(zA);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+    for (int y = rowBegin; y <= rowEnd; y++) {
+        float py = y + 0.5f;
+        __m128 r0 = _mm_set1_ps(B[0] * py + C[0]);
+        __m128 r1 = _mm_set1_ps(B[1] * py + C[1]);
+        __m128 r2 = _mm_set1_ps(B[2] * py + C[2]);
+        __m128 rz = _mm_set1_ps(zB * py + zC);
+        float* row = depth + y * OCCLUSION_WIDTH;
+
+        for (int x = xBegin; x <= tri.maxX; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffset);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), r0);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), r1);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), r2);
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                       _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            __m128 z = _mm_add_ps(_mm_mul_ps(za, px), rz);
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearest = _mm_min_ps(old, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for (int y = rowBegin; y <= rowEnd; y++) {
+        float py = y + 0.5f;
+        float* row = depth + y * OCCLUSION_WIDTH;
+        for (int x = xBegin; x <= tri.maxX; x++) {
+            float px = x + 0.5f;
+            float e0 = A[0] * px + B[0] * py + C[0];
+            float e1 = A[1] * px + B[1] * py + C[1];
+            float e2 = A[2] * px + B[2] * py + C[2];
+            if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+                row[x] = std::min(row[x], zA * px + zB * py + zC);
+        }
+    }
+#endif
+}
+
+struct OcclusionCuller {
+    std::vector<float> depth = std::vector<float>(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f);
+    std::vector<float> hiz = std::vector<float>(OCCLUSION_BLOCKS_X * OCCLUSION_BLOCKS_Y, 1.0f); // farthest per block
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    OcclusionStats stats;
+
+    // scratch, reused between frames
+    std::vector<uint32_t> occluders;
+    std::vector<std::vector<OcclusionTriangle>> occluderTriangles; // per occluder, filled in parallel
+    std::vector<OcclusionTriangle> triangles;
+
+    // Project and set up the triangles of one occluder
+    void setupOccluder(const GameObject& obj, const MeshRegistry& registry, std::vector<OcclusionTriangle>& out) const
+    {
+        out.clear();
+        const GpuMesh& gpu = registry.get(obj.mesh);
+        const glm::mat4 mvp = viewProjection * obj.model;
+
+        for (size_t t = 0; t + 2 < gpu.cpuIndices.size(); t += 3) {
+            OcclusionTriangle tri;
+            bool clipped = false;
+            for (int v = 0; v < 3; v++) {
+                glm::vec4 clip = mvp * glm::vec4(gpu.cpuPositions[gpu.cpuIndices[t + v]], 1.0f);
+                if (clip.z < -clip.w || clip.w <= 0.0f) {
+                    clipped = true;
+                    break;
+                }
+                float invW = 1.0f / clip.w;
+                tri.x[v] = (clip.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+                tri.y[v] = (clip.y * invW * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+                tri.z[v] = clip.z * invW * 0.5f + 0.5f;
+            }
+            if (clipped)
+                continue;
+
+            // back facing or degenerate
+            float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+            if (area <= 0.0f)
+                continue;
+
+            // pixels whose centers can be inside
+            float minX = std::min({ tri.x[0], tri.x[1], tri.x[2] }), maxX = std::max({ tri.x[0], tri.x[1], tri.x[2] });
+            float minY = std::min({ tri.y[0], tri.y[1], tri.y[2] }), maxY = std::max({ tri.y[0], tri.y[1], tri.y[2] });
+            tri.minX = std::max(0, static_cast<int>(std::ceil(minX - 0.5f)));
+            tri.maxX = std::min(OCCLUSION_WIDTH - 1, static_cast<int>(std::floor(maxX - 0.5f)));
+            tri.minY = std::max(0, static_cast<int>(std::ceil(minY - 0.5f)));
+            tri.maxY = std::min(OCCLUSION_HEIGHT - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+            if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+                continue;
+
+            out.push_back(tri);
+        }
+    }
+
+    // Clear, rasterize all triangles touching the band and build its HiZ blocks
+    void rasterizeBand(int band)
+    {
+        const int rowBegin = band * OCCLUSION_BAND_ROWS;
+        const int rowEnd = rowBegin + OCCLUSION_BAND_ROWS - 1;
+        std::fill(depth.begin() + rowBegin * OCCLUSION_WIDTH, depth.begin() + (rowEnd + 1) * OCCLUSION_WIDTH, 1.0f);
+
+        for (const OcclusionTriangle& tri : triangles) {
+            if (tri.maxY < rowBegin || tri.minY > rowEnd)
+                continue;
+            RasterizeOcclusionTriangle(tri, std::max(tri.minY, rowBegin), std::min(tri.maxY, rowEnd), depth.data());
+        }
+
+        for (int by = rowBegin / OCCLUSION_BLOCK; by <= rowEnd / OCCLUSION_BLOCK; by++) {
+            for (int bx = 0; bx < OCCLUSION_BLOCKS_X; bx++) {
+                float farthest = 0.0f;
+                for (int y = 0; y < OCCLUSION_BLOCK; y++) {
+                    const float* row = depth.data() + (by * OCCLUSION_BLOCK + y) * OCCLUSION_WIDTH + bx * OCCLUSION_BLOCK;
+                    for (int x = 0; x < OCCLUSION_BLOCK; x++)
+                        farthest = std::max(farthest, row[x]);
+                }
+                hiz[by * OCCLUSION_BLOCKS_X + bx] = farthest;
+            }
+        }
+    }
+
+    // Rasterize the occluders among candidates for this view
+    void render(const std::vector<GameObject>& objects, const std::vector<uint32_t>& candidates,
+                const MeshRegistry& registry, const glm::mat4& viewProjection, ThreadPool& pool)
+    {
+        auto start = std::chrono::steady_clock::now();
+        this->viewProjection = viewProjection;
+
+        occluders.clear();
+        for (uint32_t i : candidates)
+            if (objects[i].occluder && objects[i].mesh.valid())
+                occluders.push_back(i);
+
+        if (occluderTriangles.size() < occluders.size())
+            occluderTriangles.resize(occluders.size());
+        pool.parallelFor(occluders.size(), [&](size_t k) {
+            setupOccluder(objects[occluders[k]], registry, occluderTriangles[k]);
+        });
+
+        triangles.clear();
+        for (size_t k = 0; k < occluders.size(); k++)
+            triangles.insert(triangles.end(), occluderTriangles[k].begin(), occluderTriangles[k].end());
+
+        pool.parallelFor(OCCLUSION_BANDS, [&](size_t band) { rasterizeBand(static_cast<int>(band)); });
+
+        stats.occluders = occluders.size();
+        stats.triangles = triangles.size();
+        stats.rasterMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // true if the world box is behind the occluders everywhere it covers
+    bool isOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+    {
+        float minX = OCCLUSION_WIDTH, maxX = 0.0f, minY = OCCLUSION_HEIGHT, maxY = 0.0f, minZ = 1.0f;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 p((corner & 1) ? boundsMax.x : boundsMin.x,
+                        (corner & 2) ? boundsMax.y : boundsMin.y,
+                        (corner & 4) ? boundsMax.z : boundsMin.z);
+            glm::vec4 clip = viewProjection * glm::vec4(p, 1.0f);
+            if (clip.z < -clip.w || clip.w <= 0.0f)
+                return false; // crosses the near plane
+
+            float invW = 1.0f / clip.w;
+            float x = (clip.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+            float y = (clip.y * invW * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+            minZ = std::min(minZ, clip.z * invW * 0.5f + 0.5f);
+        }
+
+        int bx0 = std::max(0, static_cast<int>(std::floor(minX)) / OCCLUSION_BLOCK);
+        int bx1 = std::min(OCCLUSION_BLOCKS_X - 1, static_cast<int>(std::floor(maxX)) / OCCLUSION_BLOCK);
+        int by0 = std::max(0, static_cast<int>(std::floor(minY)) / OCCLUSION_BLOCK);
+        int by1 = std::min(OCCLUSION_BLOCKS_Y - 1, static_cast<int>(std::floor(maxY)) / OCCLUSION_BLOCK);
+        if (bx0 > bx1 || by0 > by1)
+            return false; // off screen, leave it to the frustum test
+
+        for (int by = by0; by <= by1; by++)
+            for (int bx = bx0; bx <= bx1; bx++)
+                if (hiz[by * OCCLUSION_BLOCKS_X + bx] >= minZ)
+                    return false;
+        return true;
+    }
+
+    // Keep the candidates that are not hidden, occluders always pass
+    void cull(const std::vector<uint32_t>& candidates, const std::vector<GameObject>& objects,
+              const SpatialIndex& index, std::vector<uint32_t>& survivors)
+    {
+        auto start = std::chrono::steady_clock::now();
+        survivors.clear();
+        stats.tested = stats.occluded = 0;
+
+        for (uint32_t i : candidates) {
+            if (objects[i].occluder || !index.contains(i) || stats.triangles == 0) {
+                survivors.push_back(i);
+                continue;
+            }
+            stats.tested++;
+            if (isOccluded(index.tightMin[i], index.tightMax[i]))
+                stats.occluded++;
+            else
+                survivors.push_back(i);
+        }
+        stats.testMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
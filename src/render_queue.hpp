@@ -0,0 +1,333 @@
+// Render queue
+//
+// Every visible object submits a DrawPacket with a 64 bit sort key. The queue
+// is radix sorted once per frame and then submitted in key order, binding a
+// program / texture / VAO only when it differs from the current one.
+//
+// Key layout, most significant bits first:
+//   opaque:      pass:2 | shader:6 | texture:16 | mesh:16 | depth:24   (state first, front to back)
+//   transparent: pass:2 | depth:24 (inverted) | shader:6 | texture:16 | mesh:16   (back to front)
+//
+// shader is the QueueProgram the packet is drawn with; execute binds the
+// program from it, so program switches are sorted and counted like texture
+// and VAO binds.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+enum RenderPass : uint64_t {
+    PASS_OPAQUE = 0,
+    PASS_TRANSPARENT = 1,
+};
+
+// Program of a packet (the key's shader field)
+enum QueueProgram : uint32_t {
+    PROGRAM_SINGLE = 0,     // QueuePrograms::single, one draw per packet
+    PROGRAM_INSTANCED = 1,  // QueuePrograms::instanced, runs of the same mesh in one draw
+    PROGRAM_MULTI_DRAW = 2, // the MultiDrawRenderer's program (executeMultiDraw)
+};
+
+struct DrawPacket {
+    uint64_t key;
+    uint32_t object; // index into the scene objects
+};
+
+struct RenderStats {
+    size_t objects = 0, culled = 0; // filled by the caller
+    double cullMs = 0.0;
+    size_t packets = 0;
+    size_t drawCalls = 0;
+    size_t indirectCommands = 0; // multi draw path
+    size_t programBinds = 0, programBindsSkipped = 0;
+    size_t textureBinds = 0, textureBindsSkipped = 0;
+    size_t vaoBinds = 0, vaoBindsSkipped = 0;
+
+    void print() const
+    {
+        std::cout << "Culling: " << culled << " of " << objects << " objects culled in " << cullMs << " ms\n";
+        std::cout << "Render queue: " << packets << " packets, " << drawCalls << " draw calls";
+        if (indirectCommands)
+            std::cout << " for " << indirectCommands << " indirect commands";
+        std::cout << "\n"
+                  << "  program binds " << programBinds << " (skipped " << programBindsSkipped << ")\n"
+                  << "  texture binds " << textureBinds << " (skipped " << textureBindsSkipped << ")\n"
+                  << "  VAO binds     " << vaoBinds << " (skipped " << vaoBindsSkipped << ")\n";
+    }
+};
+
+// Programs and cached locations used to execute the queue
+struct QueuePrograms {
+    GLuint single = 0;          // Model uniform
+    GLuint instanced = 0;       // model per instance
+    GLint singleModelLoc = -1;
+    GLint singleAlphaLoc = -1;
+    GLint instancedAlphaLoc = -1;
+    GLint singleLayerLoc = -1;    // texture array layer
+    GLint instancedLayerLoc = -1;
+    GLint singleAtlasRectLoc = -1; // TextureAtlas tiling
+    GLint instancedAtlasRectLoc = -1;
+    GLint singleClutLoc = -1;      // CLUT row of palettized textures
+    GLint instancedClutLoc = -1;
+};
+
+const int KEY_DEPTH_BITS = 24;
+const int KEY_MESH_BITS = 16;
+const int KEY_TEXTURE_BITS = 16;
+const int KEY_SHADER_BITS = 6;
+
+inline uint64_t MakeSortKey(RenderPass pass, uint32_t shader, uint32_t texture, uint32_t mesh, float depth01)
+{
+    const uint64_t depthMax = (1ull << KEY_DEPTH_BITS) - 1;
+    uint64_t depth = static_cast<uint64_t>(std::min(std::max(depth01, 0.0f), 1.0f) * depthMax);
+    uint64_t state = (static_cast<uint64_t>(shader & 0x3F) << (KEY_TEXTURE_BITS + KEY_MESH_BITS)) |
+                     (static_cast<uint64_t>(texture & 0xFFFF) << KEY_MESH_BITS) |
+                     (mesh & 0xFFFF);
+
+    if (pass == PASS_OPAQUE)
+        return (static_cast<uint64_t>(pass) << 62) | (state << KEY_DEPTH_BITS) | depth;
+
+    // far first
+    return (static_cast<uint64_t>(pass) << 62) | ((depthMax - depth) << 38) | state;
+}
+
+inline QueueProgram KeyProgram(uint64_t key)
+{
+    int shift = KEY_TEXTURE_BITS + KEY_MESH_BITS + ((key >> 62) == PASS_OPAQUE ? KEY_DEPTH_BITS : 0);
+    return static_cast<QueueProgram>((key >> shift) & 0x3F);
+}
+
+// Run of multi draw commands with the same pass and texture
+struct MultiDrawBatch {
+    size_t first = 0, count = 0;
+    GLuint texture = 0;
+    bool transparent = false;
+};
+
+void ResetRenderStats(RenderStats& stats, size_t packets)
+{
+    stats.packets = packets;
+    stats.drawCalls = 0;
+    stats.indirectCommands = 0;
+    stats.programBinds = stats.programBindsSkipped = 0;
+    stats.textureBinds = stats.textureBindsSkipped = 0;
+    stats.vaoBinds = stats.vaoBindsSkipped = 0;
+}
+
+// transparent pass: blend, test but don't write depth
+void SetTransparentState(bool transparent)
+{
+    if (transparent) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+    } else {
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+    }
+}
+
+struct RenderQueue {
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> scratch;
+    std::vector<glm::mat4> instanceMatrices;
+    std::vector<MultiDrawBatch> batches;
+
+    void clear() { packets.clear(); }
+
+    void submit(uint64_t key, uint32_t object) { packets.push_back({ key, object }); }
+
+    // LSD radix sort, 8 bit digits. Digits that are equal in every key are
+    // skipped, in practice most of the depth/state bytes are.
+    void sort()
+    {
+        const size_t n = packets.size();
+        if (n < 2)
+            return;
+        scratch.resize(n);
+
+        uint64_t diff = 0;
+        for (const DrawPacket& p : packets)
+            diff |= p.key ^ packets[0].key;
+
+        for (int shift = 0; shift < 64; shift += 8) {
+            if (((diff >> shift) & 0xFF) == 0)
+                continue;
+
+            size_t counts[256] = {};
+            for (const DrawPacket& p : packets)
+                counts[(p.key >> shift) & 0xFF]++;
+
+            size_t sum = 0;
+            for (size_t& c : counts) {
+                size_t count = c;
+                c = sum;
+                sum += count;
+            }
+            for (const DrawPacket& p : packets)
+                scratch[counts[(p.key >> shift) & 0xFF]++] = p;
+            packets.swap(scratch);
+        }
+    }
+
+    // Draw all packets. Runs with the same mesh and PROGRAM_INSTANCED are drawn instanced.
+    void execute(const std::vector<GameObject>& objects, MeshRegistry& registry,
+                 const QueuePrograms& programs, RenderStats& stats)
+    {
+        ResetRenderStats(stats, packets.size());
+
+        GLuint currentProgram = 0, currentTexture = 0, currentVAO = 0;
+        bool blending = false;
+        int currentMesh = -1;
+
+        auto bindProgram = [&](GLuint program) {
+            if (program == currentProgram) { stats.programBindsSkipped++; return; }
+            glUseProgram(program);
+            currentProgram = program;
+            currentMesh = -1; // alpha / layer / atlas / clut uniforms are per program
+            stats.programBinds++;
+        };
+        auto bindTexture = [&](GLuint texture) {
+            if (texture == currentTexture) { stats.textureBindsSkipped++; return; }
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+            currentTexture = texture;
+            stats.textureBinds++;
+        };
+        auto bindVAO = [&](GLuint vao) {
+            if (vao == currentVAO) { stats.vaoBindsSkipped++; return; }
+            glBindVertexArray(vao);
+            currentVAO = vao;
+            stats.vaoBinds++;
+        };
+
+        size_t i = 0;
+        while (i < packets.size()) {
+            const GameObject& obj = objects[packets[i].object];
+            GpuMesh& gpu = registry.get(obj.mesh);
+            bool transparent = (packets[i].key >> 62) == PASS_TRANSPARENT;
+            bool instancing = KeyProgram(packets[i].key) == PROGRAM_INSTANCED;
+
+            if (transparent != blending) {
+                SetTransparentState(transparent);
+                blending = transparent;
+            }
+
+            // run of packets with the same mesh
+            size_t runEnd = i + 1;
+            if (instancing)
+                while (runEnd < packets.size() && objects[packets[runEnd].object].mesh == obj.mesh &&
+                       KeyProgram(packets[runEnd].key) == PROGRAM_INSTANCED)
+                    runEnd++;
+
+            bindProgram(instancing ? programs.instanced : programs.single);
+            bindTexture(gpu.diffuseTex);
+            bindVAO(gpu.VAO);
+
+            if (currentMesh != static_cast<int>(obj.mesh.index)) {
+                glUniform1f(instancing ? programs.instancedAlphaLoc : programs.singleAlphaLoc, gpu.material.d);
+                glUniform1f(instancing ? programs.instancedLayerLoc : programs.singleLayerLoc, gpu.diffuse.layer);
+                glUniform4fv(instancing ? programs.instancedAtlasRectLoc : programs.singleAtlasRectLoc, 1, &gpu.atlasRect[0]);
+                glUniform1f(instancing ? programs.instancedClutLoc : programs.singleClutLoc, gpu.diffuse.clut);
+                currentMesh = static_cast<int>(obj.mesh.index);
+            }
+
+            if (instancing) {
+                instanceMatrices.clear();
+                for (size_t k = i; k < runEnd; k++) {
+                    const glm::mat4& model = objects[packets[k].object].model;
+                    instanceMatrices.push_back(gpu.quantized ? model * gpu.decode : model);
+                }
+                DrawInstanced(gpu, instanceMatrices.data(), instanceMatrices.size());
+            } else {
+                glm::mat4 model = gpu.quantized ? obj.model * gpu.decode : obj.model;
+                glUniformMatrix4fv(programs.singleModelLoc, 1, GL_FALSE, &model[0][0]);
+                glDrawElements(GL_TRIANGLES, gpu.indexCount, GL_UNSIGNED_INT, (void*)0);
+            }
+            stats.drawCalls++;
+            i = runEnd;
+        }
+
+        if (blending)
+            SetTransparentState(false);
+    }
+
+    // Draw all packets from the shared GeometryPool: one command per packet,
+    // one multi draw per run of packets with the same pass and texture array
+    void executeMultiDraw(const std::vector<GameObject>& objects, const MeshRegistry& registry,
+                          MultiDrawRenderer& multiDraw, RenderStats& stats)
+    {
+        ResetRenderStats(stats, packets.size());
+
+        multiDraw.begin();
+        batches.clear();
+        for (const DrawPacket& packet : packets) {
+            const GameObject& obj = objects[packet.object];
+            const GpuMesh& gpu = registry.get(obj.mesh);
+            if (!gpu.pooled.valid())
+                continue;
+
+            bool transparent = (packet.key >> 62) == PASS_TRANSPARENT;
+            if (batches.empty() || batches.back().texture != gpu.diffuseTex || batches.back().transparent != transparent) {
+                MultiDrawBatch batch;
+                batch.first = multiDraw.commands.size();
+                batch.texture = gpu.diffuseTex;
+                batch.transparent = transparent;
+                batches.push_back(batch);
+            }
+            multiDraw.add(gpu, obj.model);
+            batches.back().count++;
+        }
+
+        stats.indirectCommands = multiDraw.commands.size();
+        if (batches.empty())
+            return;
+
+        multiDraw.upload(); // program + VAO for every batch
+        stats.programBinds = stats.vaoBinds = 1;
+
+        GLuint currentTexture = 0;
+        bool blending = false;
+        for (const MultiDrawBatch& batch : batches) {
+            if (batch.transparent != blending) {
+                SetTransparentState(batch.transparent);
+                blending = batch.transparent;
+            }
+            if (batch.texture != currentTexture) {
+                glBindTexture(GL_TEXTURE_2D_ARRAY, batch.texture);
+                currentTexture = batch.texture;
+                stats.textureBinds++;
+            } else {
+                stats.textureBindsSkipped++;
+            }
+            stats.drawCalls += multiDraw.draw(batch.first, batch.count);
+        }
+
+        if (blending)
+            SetTransparentState(false);
+    }
+};
+
+// Submit the candidate objects (e.g. frustum survivors) that are visible,
+// depth = distance along the view direction / far, all drawn with program
+void SubmitSceneObjects(RenderQueue& queue, const std::vector<GameObject>& objects,
+                        const std::vector<uint32_t>& candidates,
+                        const MeshRegistry& registry, const glm::vec3& cameraPos,
+                        const glm::vec3& cameraFront, float farPlane, QueueProgram program = PROGRAM_SINGLE)
+{
+    queue.clear();
+    for (uint32_t i : candidates) {
+        const GameObject& obj = objects[i];
+        if (!obj.visible || !obj.mesh.valid())
+            continue;
+
+        const GpuMesh& gpu = registry.get(obj.mesh);
+        float depth = glm::dot(glm::vec3(obj.model[3]) - cameraPos, cameraFront) / farPlane;
+        RenderPass pass = (gpu.material.d < 1.0f) ? PASS_TRANSPARENT : PASS_OPAQUE;
+
+        queue.submit(MakeSortKey(pass, program, gpu.diffuseTex, obj.mesh.index, depth), i);
+    }
+    queue.sort();
+}
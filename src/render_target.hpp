@@ -0,0 +1,114 @@
+// Offscreen color + depth target the scene is rendered into
+//
+// The color buffer is either 16 bit (RGB565, the PS1's framebuffer depth, half
+// the fill bandwidth) or RGBA8 for comparison. Rendering into a 16 bit target
+// leaves the per fragment reduction to the hardware (GL_DITHER is on by
+// default). The result is copied to the window with glBlitFramebuffer, which
+// converts between the fixed point formats.
+//
+// The target usually has a lower internal resolution than the window (PS1
+// style 320x240); the blit scales it up with nearest filtering, keeping the
+// aspect ratio (black bars if it differs from the window's). With dynamic
+// resolution only the lower left viewScale part of it is rendered and blitted.
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+
+struct Resolution {
+    int width, height;
+};
+
+// Internal resolutions to cycle through, {0, 0} = window size
+const Resolution INTERNAL_RESOLUTIONS[] = { { 320, 240 }, { 640, 480 }, { 0, 0 } };
+const int INTERNAL_RESOLUTION_COUNT = sizeof(INTERNAL_RESOLUTIONS) / sizeof(INTERNAL_RESOLUTIONS[0]);
+
+struct RenderTarget {
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    int width = 0, height = 0;
+    GLenum colorFormat = GL_RGBA8;
+    float viewScale = 1.0f; // per axis, of width x height
+
+    int viewWidth() const { return std::max(1, static_cast<int>(width * viewScale)); }
+    int viewHeight() const { return std::max(1, static_cast<int>(height * viewScale)); }
+
+    bool create(int width, int height, GLenum colorFormat)
+    {
+        destroy();
+        this->width = width;
+        this->height = height;
+        this->colorFormat = colorFormat;
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, colorFormat, width, height);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "RenderTarget: framebuffer incomplete (0x" << std::hex << status << std::dec << ")\n";
+            destroy();
+            return false;
+        }
+        return true;
+    }
+
+    void destroy()
+    {
+        if (fbo)
+            glDeleteFramebuffers(1, &fbo);
+        if (colorBuffer)
+            glDeleteRenderbuffers(1, &colorBuffer);
+        if (depthBuffer)
+            glDeleteRenderbuffers(1, &depthBuffer);
+        fbo = colorBuffer = depthBuffer = 0;
+    }
+
+    bool is16Bit() const { return colorFormat != GL_RGBA8; }
+
+    // Render into the target from here on
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, viewWidth(), viewHeight());
+    }
+
+    // Recreate at another size with the same color format
+    bool resize(int newWidth, int newHeight)
+    {
+        if (newWidth == width && newHeight == height && fbo)
+            return true;
+        return create(newWidth, newHeight, colorFormat);
+    }
+
+    // Scale the color buffer up to the window (nearest, aspect kept), leaves
+    // the window framebuffer bound
+    void blitToWindow(int windowWidth, int windowHeight) const
+    {
+        // scaled as the full target, so the picture size stays put when viewScale changes
+        float scale = std::min(float(windowWidth) / width, float(windowHeight) / height);
+        int w = static_cast<int>(width * scale), h = static_cast<int>(height * scale);
+        int x = (windowWidth - w) / 2, y = (windowHeight - h) / 2;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+        if (w != windowWidth || h != windowHeight) {
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, viewWidth(), viewHeight(), x, y, x + w, y + h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+};
@@ -0,0 +1,141 @@
+// Shader programs and per frame uniforms
+//
+// ShaderProgram compiles + links a program and reflects all active uniform
+// locations once, so nothing looks up uniforms by name in the render loop.
+// Camera data lives in one std140 uniform buffer (FrameData) bound to
+// FRAME_UBO_BINDING and shared by every program that declares the block.
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+const GLuint FRAME_UBO_BINDING = 0;
+
+GLuint createShader(GLenum type, const char* src) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "Shader compilation error:\n" << infoLog << std::endl;
+    }
+    return shader;
+}
+
+struct ShaderProgram {
+    GLuint id = 0;
+    std::unordered_map<std::string, GLint> uniforms; // reflected at link time
+
+    bool build(const char* vertexSrc, const char* fragmentSrc)
+    {
+        GLuint vertexShader = createShader(GL_VERTEX_SHADER, vertexSrc);
+        GLuint fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentSrc);
+
+        // link
+        id = glCreateProgram();
+        glAttachShader(id, vertexShader);
+        glAttachShader(id, fragmentShader);
+        glLinkProgram(id);
+
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        GLint success;
+        glGetProgramiv(id, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(id, 512, nullptr, infoLog);
+            std::cerr << "Shader link error:\n" << infoLog << std::endl;
+            return false;
+        }
+
+        reflect();
+        return true;
+    }
+
+    void reflect()
+    {
+        uniforms.clear();
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<char> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(id, i, maxLength, &length, &size, &type, name.data());
+
+            std::string uniformName(name.data(), length);
+            GLint location = glGetUniformLocation(id, uniformName.c_str());
+            if (location < 0)
+                continue; // member of a uniform block
+
+            uniforms[uniformName] = location;
+            // arrays are reported as "name[0]", also allow plain "name"
+            size_t bracket = uniformName.find('[');
+            if (bracket != std::string::npos)
+                uniforms[uniformName.substr(0, bracket)] = location;
+        }
+
+        // shared camera block
+        GLuint frameBlock = glGetUniformBlockIndex(id, "FrameData");
+        if (frameBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(id, frameBlock, FRAME_UBO_BINDING);
+    }
+
+    // Cached location, -1 if the uniform is not active. Call at setup, keep the GLint.
+    GLint location(const std::string& name) const
+    {
+        auto it = uniforms.find(name);
+        return (it != uniforms.end()) ? it->second : -1;
+    }
+
+    void destroy()
+    {
+        glDeleteProgram(id);
+        id = 0;
+        uniforms.clear();
+    }
+};
+
+// std140 layout of the FrameData block in the shaders
+struct FrameUniforms {
+    glm::mat4 View;
+    glm::mat4 Projection;
+    glm::mat4 ViewProjection;
+    glm::vec4 CameraPos;
+};
+
+struct FrameUniformBuffer {
+    GLuint ubo = 0;
+
+    void create()
+    {
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, ubo);
+    }
+
+    // once per frame
+    void update(const FrameUniforms& frame)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    }
+
+    void destroy()
+    {
+        glDeleteBuffers(1, &ubo);
+        ubo = 0;
+    }
+};
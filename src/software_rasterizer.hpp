@@ -0,0 +1,638 @@
+// Tile binned software rasterizer (CPU backend for machines without a usable GPU)
+//
+// A frame runs in two parallel passes on the ThreadPool:
+//
+//   setup  source triangles in chunks of SOFTWARE_SETUP_CHUNK: transform by the
+//          draw's MVP, clip against the near plane, project, snap to the
+//          subpixel grid and compute the edge / depth / texcoord planes, then
+//          bin the triangle into every tile its bounds touch. Each chunk has
+//          its own bins, so there is no locking.
+//   raster one job per SOFTWARE_TILE_SIZE tile: clear it, then draw its bins
+//          chunk by chunk, i.e. in submission order, with SSE edge functions
+//          4 pixels at a time. Tiles never share pixels, so no locking either.
+//
+// Texcoords are interpolated linearly in screen space (affine, like the PS1,
+// so textures swim on large polygons), sampled nearest with clamp to edge like
+// the TexturePool. Depth test is LESS; draws with alpha < 255 blend with the
+// texel alpha and don't write depth (same as the GL transparent pass). Pixels
+// are ARGB8888, row 0 at the top, ready for an SDL streaming texture.
+//
+// The span loop is a template over a state bitmask (textured, Gouraud, depth
+// test / write, blend, dither), instantiated for every combination; the state
+// is picked once per draw from the material and the triangle's loop comes
+// from a table, so the per pixel code has no state branches. Setting
+// specializedSpans to false runs the same loop with the state read at
+// runtime instead (for comparison, see bench/software_raster_spans_bench.cpp).
+//
+// Textures come from memory (SoftwareTexture) or, with RASTER_VRAM, straight
+// from the emulated PS1 VRAM (4 / 8 bit CLUT or 15 bit texels, see vram.hpp).
+//
+// With gteVertices set the vertex stage is the fixed point GTE transform
+// (gte_transform.hpp) instead of the float MVP: a pass before setup transforms
+// every draw's quantized vertices to whole pixel screen coordinates, and setup
+// takes them from there. Like on the PS1 there is no clipping then: triangles
+// with a vertex closer than gteNearZ or at the screen coordinate limit are
+// dropped, and depth is the linear sz / 65536.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "gte_transform.hpp"
+#include "software_texture.hpp"
+#include "texture_color16.hpp"
+#include "thread_pool.hpp"
+#include "vram.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define SOFTWARE_RASTER_SSE 1
+#endif
+
+const int SOFTWARE_TILE_SIZE = 32;      // multiple of 4
+const int SOFTWARE_SETUP_CHUNK = 256;   // source triangles per setup job
+
+// Span loop state bits
+enum SoftwareRasterState : uint32_t {
+    RASTER_TEXTURED = 1 << 0,    // nearest texel, flat color otherwise
+    RASTER_GOURAUD = 1 << 1,     // interpolated vertex light modulates the color
+    RASTER_DEPTH_TEST = 1 << 2,  // LESS
+    RASTER_DEPTH_WRITE = 1 << 3,
+    RASTER_BLEND = 1 << 4,       // texel alpha * draw alpha
+    RASTER_DITHER = 1 << 5,      // PS1 4x4 dither to 5 bits per channel
+    RASTER_VRAM = 1 << 6,        // with RASTER_TEXTURED: sample vramTexture
+};
+const uint32_t SOFTWARE_RASTER_STATE_COUNT = 1 << 7;
+const uint32_t SOFTWARE_RASTER_RUNTIME_STATE = 0xFFFFFFFF; // span loop reading the state per triangle
+
+// One mesh instance to draw
+struct SoftwareDraw {
+    const glm::vec3* positions = nullptr;
+    const glm::vec2* texcoords = nullptr; // may be null
+    const glm::vec3* normals = nullptr;   // RASTER_GOURAUD only
+    const unsigned int* indices = nullptr;
+    size_t indexCount = 0;
+    glm::mat4 mvp = glm::mat4(1.0f);
+    const GteVertices* gteVertices = nullptr; // positions * GTE_VERTEX_SCALE, for the GTE vertex stage
+    GteMatrix gteMatrix = {};                 // model-view for it (GteMatrixFromGL)
+    GteProjection gteProjection;
+    const SoftwareTexture* texture = nullptr; // RASTER_TEXTURED only
+    const VramTexture* vramTexture = nullptr; // instead of texture with RASTER_VRAM
+    uint32_t color = 0xFFFFFFFF;              // ARGB, without texture
+    uint8_t alpha = 255;                      // RASTER_BLEND only
+    glm::vec3 light = glm::vec3(0.0f, 1.0f, 0.0f); // object space, towards the light
+    float ambient = 0.0f;
+    uint32_t state = RASTER_DEPTH_TEST | RASTER_DEPTH_WRITE;
+};
+
+// Screen space triangle, edge i is opposite vertex i, E(p) = A*px + B*py + C >= 0 inside
+struct SoftwareTriangle {
+    float A[3], B[3], C[3];
+    float zA, zB, zC;             // depth plane
+    float uA, uB, uC, vA, vB, vC; // texcoord planes, in texels
+    float sA, sB, sC;             // light plane, 0..256
+    int minX, maxX, minY, maxY;
+    const SoftwareTexture* texture;
+    const VramTexture* vramTexture;
+    uint32_t color;
+    uint8_t alpha;
+    uint32_t state;
+};
+
+struct SoftwareRasterStats {
+    size_t draws = 0, triangles = 0; // submitted
+    size_t setup = 0;                // after clipping / culling
+    size_t binned = 0;               // tile references
+    double setupMs = 0.0, rasterMs = 0.0;
+
+    void print() const
+    {
+        std::cout << "Software raster: " << draws << " draws, " << setup << " of " << triangles
+                  << " triangles set up, " << binned << " tile bins, setup " << setupMs
+                  << " ms, raster " << rasterMs << " ms\n";
+    }
+};
+
+struct SoftwareRasterizer {
+    int width = 0, height = 0;
+    int stride = 0; // width rounded up to 4 pixels
+    int tilesX = 0, tilesY = 0;
+    std::vector<uint32_t> color; // ARGB
+    std::vector<float> depth;    // 0..1 window depth
+
+    uint32_t clearColor = PackARGB(26, 26, 26, 255); // same as the GL glClearColor
+    int subpixelBits = 4;        // vertex snap, 0 = whole pixels (PS1 GTE wobble)
+    bool cullBackFaces = false;  // the GL path draws both sides
+    bool specializedSpans = true; // template span loops, false = generic branching loop
+    bool gteVertices = false;    // fixed point GTE vertex stage, for draws with SoftwareDraw::gteVertices
+    int gteNearZ = 16;           // GTE stage: triangles with a vertex at sz < this are dropped
+    // material state inputs (SoftwareRasterStateFor)
+    bool lighting = false;       // Gouraud for illum >= 1, the GL shaders are unlit
+    bool dither = false;         // 15 bit PS1 output
+    glm::vec3 lightDirection = glm::normalize(glm::vec3(0.4f, 1.0f, 0.3f)); // world space, towards the light
+    float ambient = 0.35f;
+
+    std::vector<size_t> drawFirst; // first source triangle of every draw, + total
+    std::vector<GteScreen> gteScreens; // per draw, GTE vertex stage output
+    std::vector<SoftwareTriangle> triangles; // 2 slots per source triangle, near clipping may split it
+    std::vector<std::vector<uint32_t>> bins; // [chunk * tile count + tile]
+    std::vector<size_t> chunkSetup;          // triangles set up per chunk
+    SoftwareRasterStats stats;
+
+    void resize(int newWidth, int newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        stride = (width + 3) & ~3;
+        tilesX = (stride + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+        tilesY = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+        color.assign(size_t(stride) * height, clearColor);
+        depth.assign(size_t(stride) * height, 1.0f);
+    }
+
+    int tileCount() const { return tilesX * tilesY; }
+
+    // Draw everything in order into color / depth (cleared first)
+    void render(const std::vector<SoftwareDraw>& draws, ThreadPool* workers)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+
+        drawFirst.resize(draws.size() + 1);
+        size_t total = 0;
+        for (size_t d = 0; d < draws.size(); d++) {
+            drawFirst[d] = total;
+            total += draws[d].indexCount / 3;
+        }
+        drawFirst[draws.size()] = total;
+
+        if (gteVertices) {
+            if (gteScreens.size() < draws.size())
+                gteScreens.resize(draws.size());
+            auto transformDraw = [&](size_t d) {
+                if (draws[d].gteVertices)
+                    GteTransform(draws[d].gteMatrix, draws[d].gteProjection, *draws[d].gteVertices, gteScreens[d]);
+            };
+            if (workers)
+                workers->parallelFor(draws.size(), transformDraw);
+            else
+                for (size_t d = 0; d < draws.size(); d++)
+                    transformDraw(d);
+        }
+
+        size_t chunks = (total + SOFTWARE_SETUP_CHUNK - 1) / SOFTWARE_SETUP_CHUNK;
+        triangles.resize(total * 2);
+        if (bins.size() < chunks * tileCount())
+            bins.resize(chunks * tileCount());
+        chunkSetup.assign(chunks, 0);
+
+        auto setupChunk = [&](size_t chunk) {
+            for (int t = 0; t < tileCount(); t++)
+                bins[chunk * tileCount() + t].clear();
+            size_t first = chunk * SOFTWARE_SETUP_CHUNK, last = std::min(total, first + SOFTWARE_SETUP_CHUNK);
+            size_t d = std::upper_bound(drawFirst.begin(), drawFirst.end(), first) - drawFirst.begin() - 1;
+            for (size_t t = first; t < last; t++) {
+                while (t >= drawFirst[d + 1])
+                    d++;
+                if (gteVertices && draws[d].gteVertices)
+                    setupGteTriangle(draws[d], gteScreens[d], (t - drawFirst[d]) * 3, t, chunk);
+                else
+                    setupSourceTriangle(draws[d], (t - drawFirst[d]) * 3, t, chunk);
+            }
+        };
+        if (workers)
+            workers->parallelFor(chunks, setupChunk);
+        else
+            for (size_t c = 0; c < chunks; c++)
+                setupChunk(c);
+
+        auto t1 = std::chrono::steady_clock::now();
+
+        auto rasterTile = [&](size_t tile) {
+            int x0 = int(tile % tilesX) * SOFTWARE_TILE_SIZE, y0 = int(tile / tilesX) * SOFTWARE_TILE_SIZE;
+            int x1 = std::min(x0 + SOFTWARE_TILE_SIZE, stride), y1 = std::min(y0 + SOFTWARE_TILE_SIZE, height);
+            for (int y = y0; y < y1; y++) {
+                std::fill_n(&color[size_t(y) * stride + x0], x1 - x0, clearColor);
+                std::fill_n(&depth[size_t(y) * stride + x0], x1 - x0, 1.0f);
+            }
+            for (size_t chunk = 0; chunk < chunks; chunk++)
+                for (uint32_t index : bins[chunk * tileCount() + tile])
+                    rasterTriangle(triangles[index], x0, x1, y0, y1);
+        };
+        if (workers)
+            workers->parallelFor(tileCount(), rasterTile);
+        else
+            for (int t = 0; t < tileCount(); t++)
+                rasterTile(t);
+
+        auto t2 = std::chrono::steady_clock::now();
+
+        stats.draws = draws.size();
+        stats.triangles = total;
+        stats.setup = stats.binned = 0;
+        for (size_t c = 0; c < chunks; c++) {
+            stats.setup += chunkSetup[c];
+            for (int t = 0; t < tileCount(); t++)
+                stats.binned += bins[c * tileCount() + t].size();
+        }
+        stats.setupMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        stats.rasterMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+    }
+
+    struct ClipVertex {
+        glm::vec4 position;
+        glm::vec2 uv;
+        float shade; // 0..256
+    };
+
+    // Texcoord and light of vertex index, position left to the vertex stage
+    static ClipVertex VertexAttributes(const SoftwareDraw& draw, unsigned int index)
+    {
+        ClipVertex v;
+        v.uv = draw.texcoords ? draw.texcoords[index] : glm::vec2(0.0f);
+        v.shade = 256.0f;
+        if ((draw.state & RASTER_GOURAUD) && draw.normals) {
+            float lambert = std::max(0.0f, glm::dot(glm::normalize(draw.normals[index]), draw.light));
+            v.shade = (draw.ambient + (1.0f - draw.ambient) * lambert) * 256.0f;
+        }
+        return v;
+    }
+
+    void binTriangle(uint32_t slot, size_t chunk)
+    {
+        chunkSetup[chunk]++;
+        const SoftwareTriangle& tri = triangles[slot];
+        for (int ty = tri.minY / SOFTWARE_TILE_SIZE; ty <= tri.maxY / SOFTWARE_TILE_SIZE; ty++)
+            for (int tx = tri.minX / SOFTWARE_TILE_SIZE; tx <= tri.maxX / SOFTWARE_TILE_SIZE; tx++)
+                bins[chunk * tileCount() + ty * tilesX + tx].push_back(slot);
+    }
+
+    // Transform and near clip source triangle `source` of draw, set up into slots 2*source, 2*source+1
+    void setupSourceTriangle(const SoftwareDraw& draw, size_t firstIndex, size_t source, size_t chunk)
+    {
+        ClipVertex in[3];
+        for (int i = 0; i < 3; i++) {
+            unsigned int index = draw.indices[firstIndex + i];
+            in[i] = VertexAttributes(draw, index);
+            in[i].position = draw.mvp * glm::vec4(draw.positions[index], 1.0f);
+        }
+
+        // trivially outside one of the frustum planes
+        for (int axis = 0; axis < 3; axis++) {
+            bool allAbove = true, allBelow = true;
+            for (int i = 0; i < 3; i++) {
+                allAbove &= in[i].position[axis] > in[i].position.w;
+                allBelow &= in[i].position[axis] < -in[i].position.w;
+            }
+            if (allAbove || allBelow)
+                return;
+        }
+
+        // near plane z >= -w, a triangle becomes up to a quad
+        ClipVertex out[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++) {
+            const ClipVertex& a = in[i];
+            const ClipVertex& b = in[(i + 1) % 3];
+            float da = a.position.z + a.position.w, db = b.position.z + b.position.w;
+            if (da >= 0.0f)
+                out[count++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                float t = da / (da - db);
+                out[count].position = a.position + (b.position - a.position) * t;
+                out[count].uv = a.uv + (b.uv - a.uv) * t;
+                out[count].shade = a.shade + (b.shade - a.shade) * t;
+                count++;
+            }
+        }
+
+        for (int k = 0; k + 2 < count; k++) {
+            uint32_t slot = static_cast<uint32_t>(source * 2 + k);
+            if (setupTriangle(draw, out[0], out[k + 1], out[k + 2], triangles[slot]))
+                binTriangle(slot, chunk);
+        }
+    }
+
+    // Source triangle `source` of draw from the GTE vertex stage output, set up into slot 2*source
+    void setupGteTriangle(const SoftwareDraw& draw, const GteScreen& screen, size_t firstIndex, size_t source,
+                          size_t chunk)
+    {
+        ClipVertex in[3];
+        const ClipVertex* v[3];
+        float x[3], y[3], z[3];
+        for (int i = 0; i < 3; i++) {
+            unsigned int index = draw.indices[firstIndex + i];
+            int sx = screen.sx[index], sy = screen.sy[index], sz = screen.sz[index];
+            // behind or too close (GteDivide saturates there), or clamped to the 11 bit range
+            if (sz < gteNearZ || sx == GTE_SCREEN_MIN || sx == GTE_SCREEN_MAX || sy == GTE_SCREEN_MIN ||
+                sy == GTE_SCREEN_MAX)
+                return;
+            in[i] = VertexAttributes(draw, index);
+            v[i] = &in[i];
+            x[i] = float(sx);
+            y[i] = float(sy);
+            z[i] = sz * (1.0f / 65536.0f);
+        }
+        uint32_t slot = static_cast<uint32_t>(source * 2);
+        if (setupPlanes(draw, v, x, y, z, triangles[slot]))
+            binTriangle(slot, chunk);
+    }
+
+    // Project, snap to the subpixel grid and build the planes, false if the triangle covers no pixel center
+    bool setupTriangle(const SoftwareDraw& draw, const ClipVertex& v0, const ClipVertex& v1,
+                       const ClipVertex& v2, SoftwareTriangle& tri) const
+    {
+        const ClipVertex* v[3] = { &v0, &v1, &v2 };
+        const float snap = float(1 << subpixelBits), invSnap = 1.0f / snap;
+        float x[3], y[3], z[3];
+        for (int i = 0; i < 3; i++) {
+            float invW = 1.0f / v[i]->position.w;
+            x[i] = std::round((v[i]->position.x * invW * 0.5f + 0.5f) * width * snap) * invSnap;
+            y[i] = std::round((0.5f - v[i]->position.y * invW * 0.5f) * height * snap) * invSnap;
+            z[i] = v[i]->position.z * invW * 0.5f + 0.5f;
+        }
+        return setupPlanes(draw, v, x, y, z, tri);
+    }
+
+    // Planes from snapped screen positions x, y (pixels), depth z (0..1) and
+    // the attributes of v, false if the triangle covers no pixel center
+    bool setupPlanes(const SoftwareDraw& draw, const ClipVertex* const v[3], float x[3], float y[3], float z[3],
+                     SoftwareTriangle& tri) const
+    {
+        const float invSnap = 1.0f / float(1 << subpixelBits);
+        const bool vram = (draw.state & RASTER_VRAM) != 0;
+        const bool hasTexture = vram ? draw.vramTexture != nullptr : draw.texture != nullptr;
+        const float texWidth = !hasTexture ? 0.0f : vram ? draw.vramTexture->width : draw.texture->width;
+        const float texHeight = !hasTexture ? 0.0f : vram ? draw.vramTexture->height : draw.texture->height;
+        float u[3], t[3], s[3];
+        for (int i = 0; i < 3; i++) {
+            u[i] = v[i]->uv.x * texWidth;
+            t[i] = v[i]->uv.y * texHeight;
+            s[i] = v[i]->shade;
+        }
+
+        // counter clockwise in GL (front facing) is negative here, y points down
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        if (area == 0.0f || (cullBackFaces && area > 0.0f))
+            return false;
+        if (area < 0.0f) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            std::swap(u[1], u[2]);
+            std::swap(t[1], t[2]);
+            std::swap(s[1], s[2]);
+            area = -area;
+        }
+
+        // clamped as floats, projected coordinates can be far outside the int range
+        float minX = std::max(std::floor(std::min({ x[0], x[1], x[2] })), 0.0f);
+        float maxX = std::min(std::ceil(std::max({ x[0], x[1], x[2] })), float(width - 1));
+        float minY = std::max(std::floor(std::min({ y[0], y[1], y[2] })), 0.0f);
+        float maxY = std::min(std::ceil(std::max({ y[0], y[1], y[2] })), float(height - 1));
+        if (minX > maxX || minY > maxY)
+            return false;
+        tri.minX = static_cast<int>(minX);
+        tri.maxX = static_cast<int>(maxX);
+        tri.minY = static_cast<int>(minY);
+        tri.maxY = static_cast<int>(maxY);
+
+        for (int i = 0; i < 3; i++) {
+            int a = (i + 1) % 3, b = (i + 2) % 3;
+            tri.A[i] = -(y[b] - y[a]);
+            tri.B[i] = x[b] - x[a];
+            tri.C[i] = -(tri.A[i] * x[a] + tri.B[i] * y[a]);
+        }
+
+        // attributes from the barycentric weights E_i / area
+        float invArea = 1.0f / area;
+        auto plane = [&](const float* value, float& pA, float& pB, float& pC) {
+            pA = (tri.A[0] * value[0] + tri.A[1] * value[1] + tri.A[2] * value[2]) * invArea;
+            pB = (tri.B[0] * value[0] + tri.B[1] * value[1] + tri.B[2] * value[2]) * invArea;
+            pC = (tri.C[0] * value[0] + tri.C[1] * value[1] + tri.C[2] * value[2]) * invArea;
+        };
+        plane(z, tri.zA, tri.zB, tri.zC);
+        plane(u, tri.uA, tri.uB, tri.uC);
+        plane(t, tri.vA, tri.vB, tri.vC);
+        plane(s, tri.sA, tri.sB, tri.sC);
+
+        // fill convention: pixel centers exactly on a right or bottom edge
+        // belong to the neighbour, E is a multiple of 2^-(2 * subpixelBits + 1) there
+        const float bias = 0.5f * invSnap * invSnap * 0.5f;
+        for (int i = 0; i < 3; i++) {
+            bool topLeft = tri.A[i] > 0.0f || (tri.A[i] == 0.0f && tri.B[i] > 0.0f);
+            if (!topLeft)
+                tri.C[i] -= bias;
+        }
+
+        tri.texture = draw.texture;
+        tri.vramTexture = draw.vramTexture;
+        tri.color = draw.color;
+        tri.alpha = draw.alpha;
+        // a textured state without a texture would sample nothing
+        tri.state = hasTexture ? draw.state : draw.state & ~uint32_t(RASTER_TEXTURED | RASTER_VRAM);
+        return true;
+    }
+
+    static uint32_t Blend(uint32_t dst, uint32_t src, int alpha)
+    {
+        uint32_t rb = ((src & 0xFF00FF) * alpha + (dst & 0xFF00FF) * (255 - alpha)) >> 8;
+        uint32_t g = ((src & 0x00FF00) * alpha + (dst & 0x00FF00) * (255 - alpha)) >> 8;
+        return 0xFF000000 | (rb & 0xFF00FF) | (g & 0x00FF00);
+    }
+
+    // rgb * shade (0..256), alpha kept
+    static uint32_t Modulate(uint32_t c, int shade)
+    {
+        uint32_t rb = (((c & 0xFF00FF) * shade) >> 8) & 0xFF00FF;
+        uint32_t g = (((c & 0x00FF00) * shade) >> 8) & 0x00FF00;
+        return (c & 0xFF000000) | rb | g;
+    }
+
+    // PS1 ordered dither and truncation to 5 bits per channel
+    static uint32_t Dither(uint32_t c, int x, int y)
+    {
+        int d = COLOR16_DITHER[y & 3][x & 3];
+        int r = std::clamp(int((c >> 16) & 0xFF) + d, 0, 255) & 0xF8;
+        int g = std::clamp(int((c >> 8) & 0xFF) + d, 0, 255) & 0xF8;
+        int b = std::clamp(int(c & 0xFF) + d, 0, 255) & 0xF8;
+        return PackARGB(r, g, b, 255);
+    }
+
+    // State bits of a span instantiation; SOFTWARE_RASTER_RUNTIME_STATE reads
+    // them from the triangle instead (the generic branching loop). For every
+    // other State the result is a compile time constant and the branches fold away.
+    template <uint32_t State>
+    static bool Has(const SoftwareTriangle& tri, uint32_t bit)
+    {
+        if constexpr (State == SOFTWARE_RASTER_RUNTIME_STATE)
+            return (tri.state & bit) != 0;
+        else
+            return (State & bit) != 0;
+    }
+
+    // VRAM texel at (u, v), 0 for the transparent color 0x0000
+    static uint32_t VramTexel(const SoftwareTriangle& tri, float u, float v)
+    {
+        const VramTexture& tex = *tri.vramTexture;
+        int tu = std::min(std::max(static_cast<int>(u), 0), tex.width - 1);
+        int tv = std::min(std::max(static_cast<int>(v), 0), tex.height - 1);
+        return tex.texel(tu, tv);
+    }
+
+    // vramTexel: the pixel's VramTexel, sampled by the span loop (RASTER_VRAM only)
+    template <uint32_t State>
+    void shadePixel(const SoftwareTriangle& tri, size_t pixel, int x, int y, float u, float v, float s,
+                    uint32_t vramTexel)
+    {
+        uint32_t c = tri.color;
+        if (Has<State>(tri, RASTER_TEXTURED) && Has<State>(tri, RASTER_VRAM)) {
+            c = vramTexel;
+        } else if (Has<State>(tri, RASTER_TEXTURED)) {
+            const SoftwareTexture& tex = *tri.texture;
+            int tu = std::min(std::max(static_cast<int>(u), 0), tex.width - 1);
+            int tv = std::min(std::max(static_cast<int>(v), 0), tex.height - 1);
+            c = tex.texel(tu, tv);
+        }
+        if (Has<State>(tri, RASTER_GOURAUD))
+            c = Modulate(c, std::min(std::max(static_cast<int>(s), 0), 256));
+        if (Has<State>(tri, RASTER_BLEND))
+            c = Blend(color[pixel], c, ((c >> 24) * tri.alpha) / 255);
+        if (Has<State>(tri, RASTER_DITHER))
+            c = Dither(c, x, y);
+        color[pixel] = c | 0xFF000000;
+    }
+
+    // Draw the part of tri inside the tile [x0, x1) x [y0, y1), one
+    // instantiation per state combination (see spanTable). VRAM texels are
+    // sampled before the depth write: the transparent 0x0000 leaves the pixel
+    // and its depth untouched, like the PS1 GPU.
+    template <uint32_t State>
+    void rasterSpans(const SoftwareTriangle& tri, int x0, int x1, int y0, int y1)
+    {
+        const int xBegin = std::max(tri.minX, x0) & ~3, xEnd = std::min(tri.maxX + 1, x1);
+        const int yBegin = std::max(tri.minY, y0), yEnd = std::min(tri.maxY + 1, y1);
+        const bool depthTest = Has<State>(tri, RASTER_DEPTH_TEST), depthWrite = Has<State>(tri, RASTER_DEPTH_WRITE);
+        const bool textured = Has<State>(tri, RASTER_TEXTURED), gouraud = Has<State>(tri, RASTER_GOURAUD);
+        const bool vram = textured && Has<State>(tri, RASTER_VRAM);
+        uint32_t texels[4] = {};
+
+#if defined(SOFTWARE_RASTER_SSE)
+        const __m128 a0 = _mm_set1_ps(tri.A[0]), a1 = _mm_set1_ps(tri.A[1]), a2 = _mm_set1_ps(tri.A[2]);
+        const __m128 za = _mm_set1_ps(tri.zA), ua = _mm_set1_ps(tri.uA), va = _mm_set1_ps(tri.vA), sa = _mm_set1_ps(tri.sA);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+        alignas(16) float us[4] = {}, vs[4] = {}, ss[4] = {};
+
+        for (int y = yBegin; y < yEnd; y++) {
+            const float py = y + 0.5f;
+            const __m128 r0 = _mm_set1_ps(tri.B[0] * py + tri.C[0]);
+            const __m128 r1 = _mm_set1_ps(tri.B[1] * py + tri.C[1]);
+            const __m128 r2 = _mm_set1_ps(tri.B[2] * py + tri.C[2]);
+            const __m128 zr = _mm_set1_ps(tri.zB * py + tri.zC);
+            const __m128 ur = _mm_set1_ps(tri.uB * py + tri.uC);
+            const __m128 vr = _mm_set1_ps(tri.vB * py + tri.vC);
+            const __m128 sr = _mm_set1_ps(tri.sB * py + tri.sC);
+            const size_t row = size_t(y) * stride;
+
+            for (int x = xBegin; x < xEnd; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), r0);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), r1);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), r2);
+                __m128 pass = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                         _mm_cmpge_ps(e2, zero));
+                if (_mm_movemask_ps(pass) == 0)
+                    continue;
+
+                float* d = &depth[row + x];
+                __m128 z = zero, stored = zero;
+                if (depthTest || depthWrite) {
+                    z = _mm_add_ps(_mm_mul_ps(za, px), zr);
+                    stored = _mm_loadu_ps(d);
+                    if (depthTest)
+                        pass = _mm_and_ps(pass, _mm_cmplt_ps(z, stored));
+                }
+                int mask = _mm_movemask_ps(pass);
+                if (mask == 0)
+                    continue;
+
+                if (textured) {
+                    _mm_store_ps(us, _mm_add_ps(_mm_mul_ps(ua, px), ur));
+                    _mm_store_ps(vs, _mm_add_ps(_mm_mul_ps(va, px), vr));
+                }
+                if (vram) {
+                    for (int lane = 0; lane < 4; lane++)
+                        if ((mask & (1 << lane)) && !(texels[lane] = VramTexel(tri, us[lane], vs[lane])))
+                            mask &= ~(1 << lane);
+                    if (mask == 0)
+                        continue;
+                    pass = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask), laneBits), laneBits));
+                }
+                if (depthWrite)
+                    _mm_storeu_ps(d, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, stored)));
+                if (gouraud)
+                    _mm_store_ps(ss, _mm_add_ps(_mm_mul_ps(sa, px), sr));
+                for (int lane = 0; lane < 4; lane++)
+                    if (mask & (1 << lane))
+                        shadePixel<State>(tri, row + x + lane, x + lane, y, us[lane], vs[lane], ss[lane], texels[lane]);
+            }
+        }
+#else
+        // same evaluation order as the SSE path, so both give the same pixels
+        for (int y = yBegin; y < yEnd; y++) {
+            const float py = y + 0.5f;
+            const float r0 = tri.B[0] * py + tri.C[0], r1 = tri.B[1] * py + tri.C[1], r2 = tri.B[2] * py + tri.C[2];
+            const float zr = tri.zB * py + tri.zC, ur = tri.uB * py + tri.uC, vr = tri.vB * py + tri.vC;
+            const float sr = tri.sB * py + tri.sC;
+            const size_t row = size_t(y) * stride;
+            for (int x = xBegin; x < xEnd; x++) {
+                const float px = x + 0.5f;
+                if (tri.A[0] * px + r0 < 0.0f || tri.A[1] * px + r1 < 0.0f || tri.A[2] * px + r2 < 0.0f)
+                    continue;
+                float z = tri.zA * px + zr;
+                if (depthTest && !(z < depth[row + x]))
+                    continue;
+                const float u = textured ? tri.uA * px + ur : 0.0f, v = textured ? tri.vA * px + vr : 0.0f;
+                if (vram && !(texels[0] = VramTexel(tri, u, v)))
+                    continue;
+                if (depthWrite)
+                    depth[row + x] = z;
+                shadePixel<State>(tri, row + x, x, y, u, v, gouraud ? tri.sA * px + sr : 0.0f, texels[0]);
+            }
+        }
+#endif
+    }
+
+    using SpanFunction = void (SoftwareRasterizer::*)(const SoftwareTriangle&, int, int, int, int);
+
+    template <size_t... States>
+    static std::array<SpanFunction, sizeof...(States)> MakeSpanTable(std::index_sequence<States...>)
+    {
+        return { &SoftwareRasterizer::rasterSpans<static_cast<uint32_t>(States)>... };
+    }
+
+    // Span loop per state bitmask, picked once per triangle
+    static const SpanFunction* spanTable()
+    {
+        static const std::array<SpanFunction, SOFTWARE_RASTER_STATE_COUNT> table =
+            MakeSpanTable(std::make_index_sequence<SOFTWARE_RASTER_STATE_COUNT>{});
+        return table.data();
+    }
+
+    void rasterTriangle(const SoftwareTriangle& tri, int x0, int x1, int y0, int y1)
+    {
+        if (specializedSpans)
+            (this->*spanTable()[tri.state])(tri, x0, x1, y0, y1);
+        else
+            rasterSpans<SOFTWARE_RASTER_RUNTIME_STATE>(tri, x0, x1, y0, y1);
+    }
+};
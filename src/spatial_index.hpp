@@ -0,0 +1,580 @@
+// Spatial index over scene object bounds
+//
+// Dynamic AABB tree (incrementally balanced BVH): every object is a leaf with a
+// fattened box, so small moves only rewrite the object's tight bounds and just
+// objects leaving their fat box are removed and reinserted. Inserts pick the
+// sibling by surface area cost and the path back to the root is rebalanced with
+// AVL style rotations, so there is never a full rebuild.
+//
+// Frustum, AABB, sphere and ray queries test nodes top down and only touch the
+// tight bounds at the leaves; results are object indices into sceneObjects.
+// Frustum queries test the leaves in SIMD batches (BatchOutsideFrustum).
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum_culling.hpp"
+
+const int32_t SPATIAL_NULL = -1;
+const int SPATIAL_STACK_SIZE = 256; // traversal depth, the tree stays ~1.44 log2(n) high
+
+struct SpatialNode {
+    glm::vec3 boundsMin, boundsMax; // fat for leaves, union of children otherwise
+    int32_t parent = SPATIAL_NULL;  // next free node while on the free list
+    int32_t child1 = SPATIAL_NULL, child2 = SPATIAL_NULL;
+    int32_t height = 0;             // 0 for leaves, -1 for free nodes
+    uint32_t object = 0;            // leaves only
+
+    bool isLeaf() const { return child1 == SPATIAL_NULL; }
+};
+
+struct RayHit {
+    uint32_t object = UINT32_MAX;
+    float distance = 0.0f;
+};
+
+inline float BoundsArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 d = boundsMax - boundsMin;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+inline bool BoundsContain(const glm::vec3& outerMin, const glm::vec3& outerMax,
+                          const glm::vec3& innerMin, const glm::vec3& innerMax)
+{
+    return glm::all(glm::lessThanEqual(outerMin, innerMin)) && glm::all(glm::lessThanEqual(innerMax, outerMax));
+}
+
+inline bool BoundsOverlap(const glm::vec3& aMin, const glm::vec3& aMax,
+                          const glm::vec3& bMin, const glm::vec3& bMax)
+{
+    return glm::all(glm::lessThanEqual(aMin, bMax)) && glm::all(glm::lessThanEqual(bMin, aMax));
+}
+
+inline bool BoundsSphereOverlap(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                                const glm::vec3& center, float radius)
+{
+    glm::vec3 d = center - glm::clamp(center, boundsMin, boundsMax);
+    return glm::dot(d, d) <= radius * radius;
+}
+
+// Slab test, entry distance in tNear (0 if the origin is inside)
+inline bool RayHitsBounds(const glm::vec3& origin, const glm::vec3& invDir,
+                          const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                          float maxDistance, float& tNear)
+{
+    glm::vec3 t0 = (boundsMin - origin) * invDir;
+    glm::vec3 t1 = (boundsMax - origin) * invDir;
+    glm::vec3 tMin = glm::min(t0, t1), tMax = glm::max(t0, t1);
+    float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+    float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+    tNear = enter;
+    return enter <= exit;
+}
+
+// Plane mask bit k set = box may cross plane k. Returns false if fully outside,
+// clears the bits of planes the box is completely inside of.
+inline bool ClassifyBounds(const Frustum& f, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                           unsigned int& planeMask)
+{
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+    for (int k = 0; k < 6; k++) {
+        if (!(planeMask & (1u << k)))
+            continue;
+        const glm::vec4& p = f.planes[k];
+        float d = glm::dot(glm::vec3(p), center) + p.w;
+        float r = glm::dot(glm::abs(glm::vec3(p)), extent);
+        if (d + r < 0.0f)
+            return false;
+        if (d - r >= 0.0f)
+            planeMask &= ~(1u << k);
+    }
+    return true;
+}
+
+struct SpatialIndex {
+    std::vector<SpatialNode> nodes;
+    int32_t root = SPATIAL_NULL;
+    int32_t freeList = SPATIAL_NULL;
+
+    // per object, indexed like sceneObjects
+    std::vector<int32_t> leafOf;           // SPATIAL_NULL if not in the tree
+    std::vector<glm::vec3> tightMin, tightMax;
+
+    float margin = 0.1f;  // fat box growth per side, absorbs small moves
+    size_t reinserts = 0; // objects that left their fat box since the last reset
+
+    size_t objectCount() const { return leafOf.size(); }
+    bool contains(uint32_t object) const { return object < leafOf.size() && leafOf[object] != SPATIAL_NULL; }
+    int height() const { return root == SPATIAL_NULL ? 0 : nodes[root].height; }
+
+    void clear()
+    {
+        nodes.clear();
+        leafOf.clear();
+        tightMin.clear();
+        tightMax.clear();
+        root = freeList = SPATIAL_NULL;
+    }
+
+    // Insert the object or move it to its new bounds
+    void update(uint32_t object, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        if (object >= leafOf.size()) {
+            leafOf.resize(object + 1, SPATIAL_NULL);
+            tightMin.resize(object + 1);
+            tightMax.resize(object + 1);
+        }
+        tightMin[object] = boundsMin;
+        tightMax[object] = boundsMax;
+
+        int32_t leaf = leafOf[object];
+        if (leaf != SPATIAL_NULL) {
+            if (BoundsContain(nodes[leaf].boundsMin, nodes[leaf].boundsMax, boundsMin, boundsMax))
+                return; // still inside the fat box
+            removeLeaf(leaf);
+            reinserts++;
+        } else {
+            leaf = allocateNode();
+            nodes[leaf].object = object;
+            leafOf[object] = leaf;
+        }
+
+        nodes[leaf].boundsMin = boundsMin - glm::vec3(margin);
+        nodes[leaf].boundsMax = boundsMax + glm::vec3(margin);
+        insertLeaf(leaf);
+    }
+
+    void remove(uint32_t object)
+    {
+        if (!contains(object))
+            return;
+        int32_t leaf = leafOf[object];
+        removeLeaf(leaf);
+        freeNode(leaf);
+        leafOf[object] = SPATIAL_NULL;
+    }
+
+    // --- Queries, results are appended ---
+
+    void queryFrustum(const Frustum& f, std::vector<uint32_t>& result) const
+    {
+        struct Entry { int32_t node; unsigned int planeMask; };
+        Entry stack[SPATIAL_STACK_SIZE];
+        int top = 0;
+        if (root != SPATIAL_NULL)
+            stack[top++] = { root, 0x3F };
+
+        // leaves still straddling a plane are gathered and tested FRUSTUM_BATCH
+        // at a time with the SIMD kernel of frustum_culling.hpp
+        const FrustumBatchPlanes planes(f);
+        alignas(32) float centerX[FRUSTUM_BATCH] = {}, centerY[FRUSTUM_BATCH] = {}, centerZ[FRUSTUM_BATCH] = {};
+        alignas(32) float extentX[FRUSTUM_BATCH] = {}, extentY[FRUSTUM_BATCH] = {}, extentZ[FRUSTUM_BATCH] = {};
+        uint32_t batch[FRUSTUM_BATCH];
+        int batched = 0;
+        auto flush = [&]() {
+            unsigned int outside = BatchOutsideFrustum(planes, centerX, centerY, centerZ, extentX, extentY, extentZ);
+            for (int lane = 0; lane < batched; lane++)
+                if (!(outside & (1u << lane)))
+                    result.push_back(batch[lane]);
+            batched = 0;
+        };
+
+        while (top > 0) {
+            Entry e = stack[--top];
+            const SpatialNode& node = nodes[e.node];
+            unsigned int mask = e.planeMask;
+
+            if (node.isLeaf()) {
+                glm::vec3 center = (tightMin[node.object] + tightMax[node.object]) * 0.5f;
+                glm::vec3 extent = (tightMax[node.object] - tightMin[node.object]) * 0.5f;
+                centerX[batched] = center.x; centerY[batched] = center.y; centerZ[batched] = center.z;
+                extentX[batched] = extent.x; extentY[batched] = extent.y; extentZ[batched] = extent.z;
+                batch[batched++] = node.object;
+                if (batched == FRUSTUM_BATCH)
+                    flush();
+                continue;
+            }
+            if (!ClassifyBounds(f, node.boundsMin, node.boundsMax, mask))
+                continue;
+            if (mask == 0) {
+                collectLeaves(e.node, result); // fully inside, no more plane tests
+                continue;
+            }
+            stack[top++] = { node.child1, mask };
+            stack[top++] = { node.child2, mask };
+        }
+        if (batched)
+            flush();
+    }
+
+    void queryBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& result) const
+    {
+        int32_t stack[SPATIAL_STACK_SIZE];
+        int top = 0;
+        if (root != SPATIAL_NULL)
+            stack[top++] = root;
+
+        while (top > 0) {
+            const SpatialNode& node = nodes[stack[--top]];
+            if (node.isLeaf()) {
+                if (BoundsOverlap(tightMin[node.object], tightMax[node.object], boundsMin, boundsMax))
+                    result.push_back(node.object);
+            } else if (BoundsOverlap(node.boundsMin, node.boundsMax, boundsMin, boundsMax)) {
+                stack[top++] = node.child1;
+                stack[top++] = node.child2;
+            }
+        }
+    }
+
+    void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const
+    {
+        int32_t stack[SPATIAL_STACK_SIZE];
+        int top = 0;
+        if (root != SPATIAL_NULL)
+            stack[top++] = root;
+
+        while (top > 0) {
+            const SpatialNode& node = nodes[stack[--top]];
+            if (node.isLeaf()) {
+                if (BoundsSphereOverlap(tightMin[node.object], tightMax[node.object], center, radius))
+                    result.push_back(node.object);
+            } else if (BoundsSphereOverlap(node.boundsMin, node.boundsMax, center, radius)) {
+                stack[top++] = node.child1;
+                stack[top++] = node.child2;
+            }
+        }
+    }
+
+    // Closest object whose bounds the ray hits within maxDistance (direction need
+    // not be normalized, distance is in units of direction)
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const
+    {
+        const glm::vec3 invDir = 1.0f / direction; // inf for axis parallel rays is fine
+        float best = maxDistance;
+        hit = RayHit{};
+
+        struct Entry { int32_t node; float tNear; };
+        Entry stack[SPATIAL_STACK_SIZE];
+        int top = 0;
+        float t;
+        if (root != SPATIAL_NULL && RayHitsBounds(origin, invDir, nodes[root].boundsMin, nodes[root].boundsMax, best, t))
+            stack[top++] = { root, t };
+
+        while (top > 0) {
+            Entry e = stack[--top];
+            if (e.tNear > best)
+                continue; // a closer hit was found meanwhile
+            const SpatialNode& node = nodes[e.node];
+
+            if (node.isLeaf()) {
+                if (RayHitsBounds(origin, invDir, tightMin[node.object], tightMax[node.object], best, t)) {
+                    best = t;
+                    hit.object = node.object;
+                    hit.distance = t;
+                }
+                continue;
+            }
+
+            // push the farther child first so the nearer one is visited next
+            float t1, t2;
+            bool hit1 = RayHitsBounds(origin, invDir, nodes[node.child1].boundsMin, nodes[node.child1].boundsMax, best, t1);
+            bool hit2 = RayHitsBounds(origin, invDir, nodes[node.child2].boundsMin, nodes[node.child2].boundsMax, best, t2);
+            if (hit1 && hit2) {
+                bool firstNear = t1 <= t2;
+                stack[top++] = firstNear ? Entry{ node.child2, t2 } : Entry{ node.child1, t1 };
+                stack[top++] = firstNear ? Entry{ node.child1, t1 } : Entry{ node.child2, t2 };
+            } else if (hit1) {
+                stack[top++] = { node.child1, t1 };
+            } else if (hit2) {
+                stack[top++] = { node.child2, t2 };
+            }
+        }
+        return hit.object != UINT32_MAX;
+    }
+
+    // --- Tree maintenance ---
+
+    int32_t allocateNode()
+    {
+        int32_t index;
+        if (freeList != SPATIAL_NULL) {
+            index = freeList;
+            freeList = nodes[index].parent;
+        } else {
+            index = static_cast<int32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        nodes[index] = SpatialNode{};
+        return index;
+    }
+
+    void freeNode(int32_t index)
+    {
+        nodes[index].parent = freeList;
+        nodes[index].height = -1;
+        freeList = index;
+    }
+
+    void collectLeaves(int32_t start, std::vector<uint32_t>& result) const
+    {
+        int32_t stack[SPATIAL_STACK_SIZE];
+        int top = 0;
+        stack[top++] = start;
+        while (top > 0) {
+            const SpatialNode& node = nodes[stack[--top]];
+            if (node.isLeaf()) {
+                result.push_back(node.object);
+            } else {
+                stack[top++] = node.child1;
+                stack[top++] = node.child2;
+            }
+        }
+    }
+
+    void refit(int32_t index)
+    {
+        SpatialNode& node = nodes[index];
+        const SpatialNode& a = nodes[node.child1];
+        const SpatialNode& b = nodes[node.child2];
+        node.boundsMin = glm::min(a.boundsMin, b.boundsMin);
+        node.boundsMax = glm::max(a.boundsMax, b.boundsMax);
+        node.height = 1 + std::max(a.height, b.height);
+    }
+
+    // Refit and rebalance from index up to the root
+    void fixUpwards(int32_t index)
+    {
+        while (index != SPATIAL_NULL) {
+            index = balance(index);
+            refit(index);
+            index = nodes[index].parent;
+        }
+    }
+
+    void insertLeaf(int32_t leaf)
+    {
+        if (root == SPATIAL_NULL) {
+            root = leaf;
+            nodes[leaf].parent = SPATIAL_NULL;
+            return;
+        }
+
+        // find the cheapest sibling by surface area
+        const glm::vec3 leafMin = nodes[leaf].boundsMin, leafMax = nodes[leaf].boundsMax;
+        int32_t index = root;
+        while (!nodes[index].isLeaf()) {
+            const SpatialNode& node = nodes[index];
+            float area = BoundsArea(node.boundsMin, node.boundsMax);
+            float combinedArea = BoundsArea(glm::min(node.boundsMin, leafMin), glm::max(node.boundsMax, leafMax));
+
+            float cost = 2.0f * combinedArea;                   // new parent here
+            float inheritance = 2.0f * (combinedArea - area);   // pushing down grows this node
+
+            auto childCost = [&](int32_t child) {
+                const SpatialNode& c = nodes[child];
+                float grown = BoundsArea(glm::min(c.boundsMin, leafMin), glm::max(c.boundsMax, leafMax));
+                return (c.isLeaf() ? grown : grown - BoundsArea(c.boundsMin, c.boundsMax)) + inheritance;
+            };
+            float cost1 = childCost(node.child1);
+            float cost2 = childCost(node.child2);
+
+            if (cost < cost1 && cost < cost2)
+                break;
+            index = (cost1 < cost2) ? node.child1 : node.child2;
+        }
+
+        int32_t sibling = index;
+        int32_t oldParent = nodes[sibling].parent;
+        int32_t newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        if (oldParent == SPATIAL_NULL) {
+            root = newParent;
+        } else if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        } else {
+            nodes[oldParent].child2 = newParent;
+        }
+
+        fixUpwards(newParent);
+    }
+
+    void removeLeaf(int32_t leaf)
+    {
+        if (leaf == root) {
+            root = SPATIAL_NULL;
+            return;
+        }
+
+        int32_t parent = nodes[leaf].parent;
+        int32_t grandParent = nodes[parent].parent;
+        int32_t sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+        nodes[sibling].parent = grandParent;
+        if (grandParent == SPATIAL_NULL) {
+            root = sibling;
+        } else {
+            if (nodes[grandParent].child1 == parent)
+                nodes[grandParent].child1 = sibling;
+            else
+                nodes[grandParent].child2 = sibling;
+        }
+        freeNode(parent);
+        fixUpwards(grandParent);
+    }
+
+    // Rotate the taller grandchild up if the children of a differ in height by
+    // more than one. Returns the node now in a's place.
+    int32_t balance(int32_t a)
+    {
+        SpatialNode& A = nodes[a];
+        if (A.isLeaf() || A.height < 2)
+            return a;
+
+        int32_t b = A.child1, c = A.child2;
+        int32_t diff = nodes[c].height - nodes[b].height;
+        if (diff > 1)
+            return rotateUp(a, c, true);
+        if (diff < -1)
+            return rotateUp(a, b, false);
+        return a;
+    }
+
+    // Move child up into a's place, a takes child's shorter subtree.
+    // childIsSecond: child is a.child2 (else a.child1).
+    int32_t rotateUp(int32_t a, int32_t child, bool childIsSecond)
+    {
+        int32_t f = nodes[child].child1, g = nodes[child].child2;
+
+        nodes[child].child1 = a;
+        nodes[child].parent = nodes[a].parent;
+        nodes[a].parent = child;
+
+        int32_t p = nodes[child].parent;
+        if (p == SPATIAL_NULL)
+            root = child;
+        else if (nodes[p].child1 == a)
+            nodes[p].child1 = child;
+        else
+            nodes[p].child2 = child;
+
+        // the taller grandchild stays with child, the other moves to a
+        int32_t keep = (nodes[f].height > nodes[g].height) ? f : g;
+        int32_t give = (keep == f) ? g : f;
+        nodes[child].child2 = keep;
+        if (childIsSecond)
+            nodes[a].child2 = give;
+        else
+            nodes[a].child1 = give;
+        nodes[give].parent = a;
+
+        refit(a);
+        refit(child);
+        return child;
+    }
+
+    // Renumber the nodes depth first so traversals walk memory mostly forwards.
+    // Incremental inserts scatter the nodes; call after bulk loading.
+    void compact()
+    {
+        std::vector<SpatialNode> ordered;
+        ordered.reserve(nodes.size());
+
+        struct Entry { int32_t node; int32_t parent; bool second; };
+        std::vector<Entry> stack;
+        if (root != SPATIAL_NULL)
+            stack.push_back({ root, SPATIAL_NULL, false });
+
+        while (!stack.empty()) {
+            Entry e = stack.back();
+            stack.pop_back();
+
+            int32_t index = static_cast<int32_t>(ordered.size());
+            ordered.push_back(nodes[e.node]);
+            SpatialNode& node = ordered.back();
+            node.parent = e.parent;
+            if (e.parent != SPATIAL_NULL)
+                (e.second ? ordered[e.parent].child2 : ordered[e.parent].child1) = index;
+
+            if (node.isLeaf()) {
+                leafOf[node.object] = index;
+            } else {
+                stack.push_back({ node.child2, index, true });
+                stack.push_back({ node.child1, index, false });
+            }
+        }
+
+        nodes.swap(ordered);
+        root = nodes.empty() ? SPATIAL_NULL : 0;
+        freeList = SPATIAL_NULL;
+    }
+
+    // Debug: parents, heights and boxes are consistent
+    bool validate() const
+    {
+        size_t leaves = 0;
+        bool ok = validateNode(root, SPATIAL_NULL, leaves);
+        size_t expected = 0;
+        for (int32_t leaf : leafOf)
+            expected += (leaf != SPATIAL_NULL);
+        return ok && leaves == expected;
+    }
+
+    bool validateNode(int32_t index, int32_t parent, size_t& leaves) const
+    {
+        if (index == SPATIAL_NULL)
+            return true;
+        const SpatialNode& node = nodes[index];
+        if (node.parent != parent)
+            return false;
+        if (node.isLeaf()) {
+            leaves++;
+            return node.height == 0 && leafOf[node.object] == index &&
+                   BoundsContain(node.boundsMin, node.boundsMax, tightMin[node.object], tightMax[node.object]);
+        }
+        const SpatialNode& a = nodes[node.child1];
+        const SpatialNode& b = nodes[node.child2];
+        if (node.height != 1 + std::max(a.height, b.height))
+            return false;
+        if (!BoundsContain(node.boundsMin, node.boundsMax, a.boundsMin, a.boundsMax) ||
+            !BoundsContain(node.boundsMin, node.boundsMax, b.boundsMin, b.boundsMax))
+            return false;
+        return validateNode(node.child1, index, leaves) && validateNode(node.child2, index, leaves);
+    }
+};
+
+// Insert new objects and move the ones with boundsDirty, drop objects without a
+// mesh. The index follows sceneObjects by position, like CullingSoA.
+void SyncSpatialIndex(std::vector<GameObject>& objects, const MeshRegistry& registry, SpatialIndex& index)
+{
+    for (size_t i = objects.size(); i < index.objectCount(); i++)
+        index.remove(static_cast<uint32_t>(i));
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        GameObject& obj = objects[i];
+        uint32_t object = static_cast<uint32_t>(i);
+        if (!obj.boundsDirty && index.contains(object))
+            continue;
+        obj.boundsDirty = false;
+
+        if (!obj.mesh.valid()) {
+            index.remove(object);
+            continue;
+        }
+        const GpuMesh& gpu = registry.get(obj.mesh);
+        glm::vec3 center, extent;
+        TransformBounds(obj.model, gpu.boundsMin, gpu.boundsMax, center, extent);
+        index.update(object, center - extent, center + extent);
+    }
+}
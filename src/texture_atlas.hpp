@@ -0,0 +1,413 @@
+// Texture atlas built at load time
+//
+// Small diffuse textures are packed into shared RGBA pages (skyline packer,
+// bottom-left heuristic) and LoadOBJ rewrites the mesh texcoords into page
+// space, so meshes that used different small textures end up on the same
+// TexturePool layer and batch together.
+//
+// Every entry gets a gutter of replicated edge texels and its position and
+// padded size are aligned to 2^(levels-1), so each of the page's mip levels
+// still has a gutter of at least one texel and no mip texel mixes two entries.
+// With a TEXTURE_BC pool the alignment is 4 * 2^(levels-1) instead, so no 4x4
+// block of any level spans two entries either; the replicated edges then fill
+// the whole aligned padding.
+//
+// The layout (which texture went where) is saved to layoutPath; later runs
+// reuse it and only blit the images into place. It is dropped and packed again
+// when a source image changed (stamps as in the cooked mesh cache) or the page
+// settings differ.
+//
+// Meshes with texcoords outside [0, 1] cannot simply be remapped. Depending on
+// wrapMode they keep their own texture (ATLAS_WRAP_EXCLUDE) or keep their
+// texcoords and get Mesh::atlasRect, which the fragment shader uses to tile
+// fract(uv) inside the entry (ATLAS_WRAP_TILE).
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <json.hpp>
+
+#include "mesh.hpp"
+#include "mesh_cache.hpp"
+#include "stb_image.h"
+#include "texture_pool.hpp"
+
+const uint32_t ATLAS_LAYOUT_VERSION = 1;
+
+enum AtlasWrapMode {
+    ATLAS_WRAP_EXCLUDE, // meshes with wrapping texcoords keep their own texture
+    ATLAS_WRAP_TILE,    // tiled in the shader through Mesh::atlasRect
+};
+
+// Skyline bin packer, x/y in texels, segments sorted by x and covering the width
+struct SkylinePacker {
+    struct Segment {
+        int x, y, width;
+    };
+
+    int width = 0, height = 0;
+    std::vector<Segment> skyline;
+
+    void reset(int w, int h)
+    {
+        width = w;
+        height = h;
+        skyline.assign(1, Segment{ 0, 0, w });
+    }
+
+    // Lowest y at which a w x h rect fits with its left edge on segment i, -1 if it doesn't
+    int fit(size_t i, int w, int h) const
+    {
+        int x = skyline[i].x;
+        if (x + w > width)
+            return -1;
+        int y = 0;
+        for (int left = w; left > 0; i++) {
+            y = std::max(y, skyline[i].y);
+            if (y + h > height)
+                return -1;
+            left -= skyline[i].width;
+        }
+        return y;
+    }
+
+    // Bottom-left: lowest top edge first, then the narrower segment
+    bool insert(int w, int h, int& outX, int& outY)
+    {
+        int bestTop = INT_MAX, bestWidth = INT_MAX;
+        size_t best = SIZE_MAX;
+        for (size_t i = 0; i < skyline.size(); i++) {
+            int y = fit(i, w, h);
+            if (y < 0)
+                continue;
+            if (y + h < bestTop || (y + h == bestTop && skyline[i].width < bestWidth)) {
+                bestTop = y + h;
+                bestWidth = skyline[i].width;
+                best = i;
+                outY = y;
+            }
+        }
+        if (best == SIZE_MAX)
+            return false;
+        outX = skyline[best].x;
+
+        // new segment on top of the rect, shrink / remove the ones it covers
+        skyline.insert(skyline.begin() + best, Segment{ outX, outY + h, w });
+        for (size_t i = best + 1; i < skyline.size();) {
+            Segment& s = skyline[i];
+            int covered = outX + w - s.x;
+            if (covered <= 0)
+                break;
+            if (covered < s.width) {
+                s.x += covered;
+                s.width -= covered;
+                break;
+            }
+            skyline.erase(skyline.begin() + i);
+        }
+        // merge neighbours at the same height
+        for (size_t i = 0; i + 1 < skyline.size();) {
+            if (skyline[i].y == skyline[i + 1].y) {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
+            } else {
+                i++;
+            }
+        }
+        return true;
+    }
+};
+
+// Where one source image lives, x/y/w/h of the image itself (gutter excluded)
+struct AtlasEntry {
+    std::string path; // material path (relative to TextureAtlas::dir)
+    int page = 0;
+    int x = 0, y = 0, width = 0, height = 0;
+    CookedSourceStamp stamp;
+    bool blitted = false; // pixels copied into the page this run
+};
+
+struct AtlasPage {
+    SkylinePacker packer;
+    std::vector<uint8_t> pixels; // RGBA, row 0 at the bottom like the flipped stb load
+    bool dirty = false;          // changed since it was handed to the pool
+};
+
+struct TextureAtlas {
+    std::string dir = "assets/";              // material paths are relative to it
+    std::string layoutPath = "assets/atlas.json";
+    int pageSize = 1024;
+    int levels = 4;                           // mip levels of the pages
+    int maxEntrySize = 512;                   // larger textures are not atlased
+    AtlasWrapMode wrapMode = ATLAS_WRAP_TILE;
+    TexturePool* pool = nullptr;              // pages are handed to it as they change
+
+    std::vector<AtlasPage> pages;
+    std::vector<AtlasEntry> entries;
+    std::unordered_map<std::string, uint32_t> byPath;
+    std::unordered_map<std::string, bool> rejected; // too large / failed to load
+    bool layoutDirty = false;
+
+    // gutter and alignment in texels (mip level 0)
+    int gutter() const { return 1 << (levels - 1); }
+    int alignment() const { return pool && pool->storage == TEXTURE_BC ? 4 << (levels - 1) : gutter(); }
+    int paddedSize(int size) const { return AlignUp(size + 2 * gutter(), alignment()); }
+
+    // Material path of a page, the pool key is dir + this
+    static std::string PageName(int page) { return "atlas_page" + std::to_string(page); }
+
+    static int AlignUp(int value, int align) { return (value + align - 1) / align * align; }
+
+    void addPage()
+    {
+        AtlasPage page;
+        page.packer.reset(pageSize, pageSize);
+        pages.push_back(std::move(page));
+    }
+
+    // Reuse the saved layout, false (and an empty atlas) if there is none or it is stale
+    bool load()
+    {
+        clear();
+
+        std::ifstream file(layoutPath);
+        if (!file.is_open())
+            return false;
+
+        nlohmann::json layout = nlohmann::json::parse(file, nullptr, false);
+        if (layout.is_discarded() || layout.value("version", 0u) != ATLAS_LAYOUT_VERSION ||
+            layout.value("pageSize", 0) != pageSize || layout.value("levels", 0) != levels ||
+            layout.value("alignment", 0) != alignment()) {
+            std::cout << "Texture atlas: layout " << layoutPath << " outdated, repacking\n";
+            return false;
+        }
+
+        for (const nlohmann::json& skyline : layout["pages"]) {
+            addPage();
+            SkylinePacker& packer = pages.back().packer;
+            packer.skyline.clear();
+            for (const nlohmann::json& s : skyline)
+                packer.skyline.push_back({ s[0].get<int>(), s[1].get<int>(), s[2].get<int>() });
+        }
+
+        for (const nlohmann::json& e : layout["entries"]) {
+            AtlasEntry entry;
+            entry.path = e["path"].get<std::string>();
+            entry.page = e["page"].get<int>();
+            entry.x = e["x"].get<int>();
+            entry.y = e["y"].get<int>();
+            entry.width = e["width"].get<int>();
+            entry.height = e["height"].get<int>();
+            entry.stamp.size = e["size"].get<uint64_t>();
+            entry.stamp.mtime = e["mtime"].get<int64_t>();
+            entry.stamp.hash = e["hash"].get<uint64_t>();
+
+            if (entry.page < 0 || entry.page >= static_cast<int>(pages.size()) ||
+                !StampStillValid(dir + entry.path, entry.stamp)) {
+                std::cout << "Texture atlas: " << entry.path << " changed, repacking\n";
+                clear();
+                return false;
+            }
+            byPath[entry.path] = static_cast<uint32_t>(entries.size());
+            entries.push_back(entry);
+        }
+
+        for (AtlasPage& page : pages)
+            page.pixels.assign(size_t(pageSize) * pageSize * 4, 0);
+        return true;
+    }
+
+    // Write the layout if anything was packed since it was loaded
+    bool save()
+    {
+        if (!layoutDirty)
+            return true;
+
+        nlohmann::json layout;
+        layout["version"] = ATLAS_LAYOUT_VERSION;
+        layout["pageSize"] = pageSize;
+        layout["levels"] = levels;
+        layout["alignment"] = alignment();
+        layout["pages"] = nlohmann::json::array();
+        for (const AtlasPage& page : pages) {
+            nlohmann::json skyline = nlohmann::json::array();
+            for (const SkylinePacker::Segment& s : page.packer.skyline)
+                skyline.push_back({ s.x, s.y, s.width });
+            layout["pages"].push_back(skyline);
+        }
+        layout["entries"] = nlohmann::json::array();
+        for (const AtlasEntry& entry : entries)
+            layout["entries"].push_back({
+                { "path", entry.path }, { "page", entry.page },
+                { "x", entry.x }, { "y", entry.y }, { "width", entry.width }, { "height", entry.height },
+                { "size", entry.stamp.size }, { "mtime", entry.stamp.mtime }, { "hash", entry.stamp.hash },
+            });
+
+        std::ofstream file(layoutPath);
+        if (!file.is_open()) {
+            std::cerr << "Texture atlas: cannot write " << layoutPath << "\n";
+            return false;
+        }
+        file << layout.dump(1) << "\n";
+        layoutDirty = false;
+        return true;
+    }
+
+    // Copy the image into its rect and replicate the edges into the padding
+    void blit(const AtlasEntry& entry, const uint8_t* rgba)
+    {
+        AtlasPage& page = pages[entry.page];
+        int g = gutter();
+        int endX = paddedSize(entry.width) - g, endY = paddedSize(entry.height) - g;
+        for (int y = -g; y < endY; y++) {
+            int py = entry.y + y;
+            if (py < 0 || py >= pageSize)
+                continue;
+            int sy = std::clamp(y, 0, entry.height - 1);
+            for (int x = -g; x < endX; x++) {
+                int px = entry.x + x;
+                if (px < 0 || px >= pageSize)
+                    continue;
+                int sx = std::clamp(x, 0, entry.width - 1);
+                std::memcpy(&page.pixels[(size_t(py) * pageSize + px) * 4],
+                            &rgba[(size_t(sy) * entry.width + sx) * 4], 4);
+            }
+        }
+        page.dirty = true;
+    }
+
+    // Entry of the texture at path (relative to dir), packing it if it is new.
+    // nullptr if it can't be atlased.
+    const AtlasEntry* place(const std::string& path)
+    {
+        auto it = byPath.find(path);
+        if (it != byPath.end() && entries[it->second].blitted)
+            return &entries[it->second];
+        if (rejected.count(path))
+            return nullptr;
+
+        stbi_set_flip_vertically_on_load(true); // same orientation as the TexturePool
+        int width, height, channels;
+        unsigned char* data = stbi_load((dir + path).c_str(), &width, &height, &channels, 4);
+        if (!data || width > maxEntrySize || height > maxEntrySize) {
+            if (data)
+                stbi_image_free(data);
+            rejected[path] = true;
+            return nullptr;
+        }
+
+        // saved rect still matches the image
+        if (it != byPath.end()) {
+            AtlasEntry& entry = entries[it->second];
+            if (entry.width == width && entry.height == height) {
+                blit(entry, data);
+                entry.blitted = true;
+                stbi_image_free(data);
+                return &entry;
+            }
+            byPath.erase(it); // its space stays used until the next repack
+        }
+
+        int g = gutter();
+        int paddedW = paddedSize(width), paddedH = paddedSize(height);
+        int x = 0, y = 0, page = 0;
+        while (page < static_cast<int>(pages.size()) && !pages[page].packer.insert(paddedW, paddedH, x, y))
+            page++;
+        if (page == static_cast<int>(pages.size())) {
+            addPage();
+            pages.back().pixels.assign(size_t(pageSize) * pageSize * 4, 0);
+            pages.back().packer.insert(paddedW, paddedH, x, y);
+        }
+
+        AtlasEntry entry;
+        entry.path = path;
+        entry.page = page;
+        entry.x = x + g;
+        entry.y = y + g;
+        entry.width = width;
+        entry.height = height;
+        StampFile(dir + path, entry.stamp, true);
+        entry.blitted = true;
+        blit(entry, data);
+        stbi_image_free(data);
+
+        byPath[path] = static_cast<uint32_t>(entries.size());
+        entries.push_back(entry);
+        layoutDirty = true;
+        return &entries.back();
+    }
+
+    // Move the mesh's diffuse texture into the atlas and its texcoords into
+    // page space. false if the mesh keeps its own texture.
+    bool remap(Mesh& mesh)
+    {
+        const std::string& path = mesh.material.diffuseTexPath;
+        if (path.empty() || path.compare(0, 10, "atlas_page") == 0)
+            return false;
+
+        const float eps = 1e-4f;
+        bool wraps = false;
+        for (const glm::vec2& uv : mesh.texcoords)
+            wraps |= uv.x < -eps || uv.y < -eps || uv.x > 1.0f + eps || uv.y > 1.0f + eps;
+        if (wraps && wrapMode == ATLAS_WRAP_EXCLUDE)
+            return false;
+
+        const AtlasEntry* entry = place(path);
+        if (!entry)
+            return false;
+
+        glm::vec2 offset = glm::vec2(entry->x, entry->y) / float(pageSize);
+        glm::vec2 scale = glm::vec2(entry->width, entry->height) / float(pageSize);
+        if (wraps) {
+            mesh.atlasRect = glm::vec4(offset, scale);
+        } else {
+            for (glm::vec2& uv : mesh.texcoords)
+                uv = offset + glm::clamp(uv, 0.0f, 1.0f) * scale;
+        }
+        mesh.material.diffuseTexPath = PageName(entry->page);
+
+        publish();
+        return true;
+    }
+
+    // Hand changed pages to the pool
+    void publish()
+    {
+        if (!pool)
+            return;
+        for (size_t p = 0; p < pages.size(); p++) {
+            if (!pages[p].dirty)
+                continue;
+            pool->setImage(dir + PageName(static_cast<int>(p)), pageSize, pageSize, levels, pages[p].pixels.data());
+            pages[p].dirty = false;
+        }
+    }
+
+    void clear()
+    {
+        pages.clear();
+        entries.clear();
+        byPath.clear();
+        rejected.clear();
+        layoutDirty = false;
+    }
+
+    void printStats() const
+    {
+        size_t used = 0;
+        for (const AtlasEntry& entry : entries)
+            used += size_t(entry.width) * entry.height;
+        std::cout << "Texture atlas: " << entries.size() << " textures on " << pages.size() << " pages of "
+                  << pageSize << "x" << pageSize << ", "
+                  << (pages.empty() ? 0.0 : 100.0 * used / (double(pageSize) * pageSize * pages.size()))
+                  << "% used\n";
+    }
+};
@@ -0,0 +1,102 @@
+// 16 bit color conversion (RGB565 / RGBA5551)
+//
+// RGBA8 images are reduced to 16 bits per texel at load time, optionally with
+// the PS1's 4x4 ordered dither (offsets -4..+3 added before truncation), so
+// gradients band less at 5 bits per channel. The SSE2 path converts 4 pixels
+// per step: widen to 16 bit, add the dither row, saturate back to bytes, then
+// shift the channels into place in 32 bit lanes and pack.
+//
+// Layouts match the GL packed types: RGB565 is GL_RGB / GL_UNSIGNED_SHORT_5_6_5
+// (red in the high bits), RGBA5551 is GL_RGBA / GL_UNSIGNED_SHORT_5_5_5_1 with
+// alpha in bit 0, set for alpha >= 128.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define COLOR16_SSE 1
+#endif
+
+// PS1 GPU dither matrix
+const int8_t COLOR16_DITHER[4][4] = {
+    { -4, +0, -3, +1 },
+    { +2, -2, +3, -1 },
+    { -3, +1, -4, +0 },
+    { +3, -1, +2, -2 },
+};
+
+inline uint16_t PackColor16(int r, int g, int b, int a, bool alpha)
+{
+    if (alpha)
+        return static_cast<uint16_t>(((r >> 3) << 11) | ((g >> 3) << 6) | ((b >> 3) << 1) | (a >= 128 ? 1 : 0));
+    return static_cast<uint16_t>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+void ConvertRowColor16Scalar(const uint8_t* rgba, int x0, int width, int y, bool alpha, bool dither, uint16_t* out)
+{
+    for (int x = x0; x < width; x++) {
+        const uint8_t* p = &rgba[x * 4];
+        int d = dither ? COLOR16_DITHER[y & 3][x & 3] : 0;
+        int r = std::clamp(p[0] + d, 0, 255), g = std::clamp(p[1] + d, 0, 255), b = std::clamp(p[2] + d, 0, 255);
+        out[x] = PackColor16(r, g, b, p[3], alpha);
+    }
+}
+
+// One row of RGBA8 pixels to 16 bit, y selects the dither row
+void ConvertRowColor16(const uint8_t* rgba, int width, int y, bool alpha, bool dither, uint16_t* out)
+{
+    int x = 0;
+#if defined(COLOR16_SSE)
+    // dither offsets of pixels 0,1 and 2,3 of a 4 pixel group, alpha untouched
+    const int8_t* row = COLOR16_DITHER[y & 3];
+    auto offsets = [&](int a, int b) {
+        int16_t da = dither ? row[a] : 0, db = dither ? row[b] : 0;
+        return _mm_setr_epi16(da, da, da, 0, db, db, db, 0);
+    };
+    const __m128i dither01 = offsets(0, 1), dither23 = offsets(2, 3);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask5 = _mm_set1_epi32(0x1F), mask6 = _mm_set1_epi32(0x3F);
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&rgba[x * 4]));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(px, zero), dither01);
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(px, zero), dither23);
+        px = _mm_packus_epi16(lo, hi); // back to RGBA8, clamped to 0..255
+
+        __m128i r = _mm_and_si128(_mm_srli_epi32(px, 3), mask5);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(px, 19), mask5);
+        __m128i packed;
+        if (alpha) {
+            __m128i g = _mm_and_si128(_mm_srli_epi32(px, 11), mask5);
+            __m128i a = _mm_srli_epi32(px, 31); // alpha >= 128
+            packed = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 11), _mm_slli_epi32(g, 6)),
+                                  _mm_or_si128(_mm_slli_epi32(b, 1), a));
+        } else {
+            __m128i g = _mm_and_si128(_mm_srli_epi32(px, 10), mask6);
+            packed = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 11), _mm_slli_epi32(g, 5)), b);
+        }
+        // sign extend the low 16 bits so the signed saturating pack keeps them as is
+        packed = _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&out[x]), _mm_packs_epi32(packed, packed));
+    }
+#endif
+    ConvertRowColor16Scalar(rgba, x, width, y, alpha, dither, out);
+}
+
+void ConvertImageColor16(const uint8_t* rgba, int width, int height, bool alpha, bool dither, std::vector<uint16_t>& out)
+{
+    out.resize(size_t(width) * height);
+    for (int y = 0; y < height; y++)
+        ConvertRowColor16(&rgba[size_t(y) * width * 4], width, y, alpha, dither, &out[size_t(y) * width]);
+}
+
+bool ImageHasAlpha(const uint8_t* rgba, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        if (rgba[i * 4 + 3] != 255)
+            return true;
+    return false;
+}
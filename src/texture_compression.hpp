@@ -0,0 +1,306 @@
+// BC1 / BC3 (DXT1 / DXT5) texture compression with stb_dxt
+//
+// The mip chain is built on the CPU (glGenerateMipmap does not work on
+// compressed textures) and every level is encoded in 4x4 blocks, one job per
+// row of blocks on the ThreadPool. Images with any alpha below 255 become BC3,
+// the rest BC1 (8 vs 4 bytes per texel for RGBA8).
+//
+// The result is cached as "<image>.bc" next to the source, so warm starts map
+// the file and upload it as is. Layout:
+//
+//   CompressedTextureHeader
+//   uint64 level sizes[levels]
+//   level payloads, each aligned to COOKED_ALIGNMENT
+//
+// The cache is rebuilt when the version changes or the source image changed
+// (same size / mtime / hash check as the cooked mesh cache).
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+#include "stb_image.h"
+#include "thread_pool.hpp"
+
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+const char COMPRESSED_TEXTURE_MAGIC[8] = { 'P', 'S', 'X', 'B', 'C', 'T', 'X', '\0' };
+const uint32_t COMPRESSED_TEXTURE_VERSION = 1;
+
+struct CompressedTextureHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t format; // GL internal format
+    int32_t width, height;
+    uint32_t levels;
+    uint32_t pad;
+    CookedSourceStamp source;
+};
+
+// All levels of one compressed image, level 0 first
+struct CompressedImage {
+    GLenum format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    int width = 0, height = 0;
+    std::vector<std::vector<uint8_t>> levels;
+};
+
+bool IsCompressedFormat(GLenum internalFormat)
+{
+    return internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+int TextureMipLevels(int width, int height)
+{
+    int levels = 1;
+    while ((width | height) >> levels)
+        levels++;
+    return levels;
+}
+
+// Header check of a cooked texture before its levels are read: a positive
+// size and 1 up to the full mip chain (which also keeps width >> level valid)
+bool CookedTextureSizeValid(int width, int height, uint32_t levels)
+{
+    return width > 0 && height > 0 && levels >= 1 && levels <= uint32_t(TextureMipLevels(width, height));
+}
+
+// A file backed cache must still have the size of its source image (only the
+// image header is read)
+bool CookedTextureMatchesSource(const std::string& imagePath, int width, int height)
+{
+    int w, h, channels;
+    return stbi_info(imagePath.c_str(), &w, &h, &channels) && w == width && h == height;
+}
+
+bool IsColor16Format(GLenum internalFormat)
+{
+    return internalFormat == GL_RGB565 || internalFormat == GL_RGB5 || internalFormat == GL_RGB5_A1;
+}
+
+// Bytes of one width x height level in internalFormat (RGBA8, 16 bit, R8 or BC1 / BC3)
+size_t TextureLevelBytes(GLenum internalFormat, int width, int height)
+{
+    width = std::max(1, width);
+    height = std::max(1, height);
+    if (internalFormat == GL_R8)
+        return size_t(width) * height;
+    if (IsColor16Format(internalFormat))
+        return size_t(width) * height * 2;
+    if (!IsCompressedFormat(internalFormat))
+        return size_t(width) * height * 4;
+    size_t blocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16);
+}
+
+std::string CompressedTexturePath(const std::string& imagePath)
+{
+    return imagePath + ".bc";
+}
+
+// 2x2 box filter, odd edges repeat the last texel
+void DownsampleRGBA(const uint8_t* src, int width, int height, std::vector<uint8_t>& dst)
+{
+    int w = std::max(1, width / 2), h = std::max(1, height / 2);
+    dst.resize(size_t(w) * h * 4);
+    for (int y = 0; y < h; y++) {
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < w; x++) {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < 4; c++) {
+                int sum = src[(size_t(y0) * width + x0) * 4 + c] + src[(size_t(y0) * width + x1) * 4 + c] +
+                          src[(size_t(y1) * width + x0) * 4 + c] + src[(size_t(y1) * width + x1) * 4 + c];
+                dst[(size_t(y) * w + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+// Encode one RGBA8 level, each row of 4x4 blocks is one job on workers (if any)
+void CompressLevel(const uint8_t* rgba, int width, int height, GLenum format,
+                   std::vector<uint8_t>& out, ThreadPool* workers)
+{
+    const bool alpha = format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    const int blockBytes = alpha ? 16 : 8;
+    const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    out.resize(size_t(blocksX) * blocksY * blockBytes);
+
+    auto encodeRow = [&](size_t by) {
+        uint8_t block[16 * 4];
+        for (int bx = 0; bx < blocksX; bx++) {
+            // partial edge blocks repeat the last row / column
+            for (int y = 0; y < 4; y++) {
+                int sy = std::min(int(by) * 4 + y, height - 1);
+                for (int x = 0; x < 4; x++) {
+                    int sx = std::min(bx * 4 + x, width - 1);
+                    std::memcpy(&block[(y * 4 + x) * 4], &rgba[(size_t(sy) * width + sx) * 4], 4);
+                }
+            }
+            stb_compress_dxt_block(&out[(by * blocksX + bx) * blockBytes], block, alpha ? 1 : 0, STB_DXT_NORMAL);
+        }
+    };
+
+    if (workers)
+        workers->parallelFor(blocksY, encodeRow);
+    else
+        for (int by = 0; by < blocksY; by++)
+            encodeRow(by);
+}
+
+// Full mip chain (or maxLevels) of an RGBA8 image. format 0 picks BC3 if any
+// texel has alpha, BC1 otherwise.
+void CompressImage(const uint8_t* rgba, int width, int height, int maxLevels,
+                   CompressedImage& image, ThreadPool* workers, GLenum format = 0)
+{
+    if (format == 0) {
+        bool hasAlpha = false;
+        for (size_t i = 0, n = size_t(width) * height; i < n && !hasAlpha; i++)
+            hasAlpha = rgba[i * 4 + 3] != 255;
+        format = hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    }
+
+    image.format = format;
+    image.width = width;
+    image.height = height;
+    image.levels.clear();
+
+    std::vector<uint8_t> level(rgba, rgba + size_t(width) * height * 4), next;
+    int w = width, h = height;
+    for (int l = 0; l < maxLevels; l++) {
+        image.levels.emplace_back();
+        CompressLevel(level.data(), w, h, image.format, image.levels.back(), workers);
+        if (w == 1 && h == 1)
+            break;
+        DownsampleRGBA(level.data(), w, h, next);
+        level.swap(next);
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+}
+
+bool LoadCompressedCache(const std::string& imagePath, CompressedImage& image)
+{
+    MappedFile file;
+    if (!file.open(CompressedTexturePath(imagePath)) || file.size < sizeof(CompressedTextureHeader))
+        return false;
+
+    CompressedTextureHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+    CookedSourceStamp source;
+    if (std::memcmp(header.magic, COMPRESSED_TEXTURE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != COMPRESSED_TEXTURE_VERSION || !IsCompressedFormat(header.format) ||
+        !CookedTextureSizeValid(header.width, header.height, header.levels) ||
+        !StampStillValid(imagePath, header.source, &source) ||
+        !CookedTextureMatchesSource(imagePath, header.width, header.height))
+        return false;
+
+    size_t tableEnd = sizeof(header) + header.levels * sizeof(uint64_t);
+    if (file.size < tableEnd)
+        return false;
+    std::vector<uint64_t> sizes(header.levels);
+    std::memcpy(sizes.data(), file.data + sizeof(header), header.levels * sizeof(uint64_t));
+
+    image.format = header.format;
+    image.width = header.width;
+    image.height = header.height;
+    image.levels.resize(header.levels);
+
+    uint64_t offset = tableEnd;
+    for (uint32_t l = 0; l < header.levels; l++) {
+        offset = (offset + COOKED_ALIGNMENT - 1) & ~(COOKED_ALIGNMENT - 1);
+        if (offset + sizes[l] > file.size ||
+            sizes[l] != TextureLevelBytes(header.format, header.width >> l, header.height >> l))
+            return false;
+        image.levels[l].assign(file.data + offset, file.data + offset + sizes[l]);
+        offset += sizes[l];
+    }
+
+    if (source.mtime != header.source.mtime) {
+        file.close();
+        RefreshCookedStamp(CompressedTexturePath(imagePath), offsetof(CompressedTextureHeader, source), source);
+    }
+    return true;
+}
+
+bool WriteCompressedCache(const std::string& imagePath, const CompressedImage& image)
+{
+    CompressedTextureHeader header = {};
+    std::memcpy(header.magic, COMPRESSED_TEXTURE_MAGIC, sizeof(header.magic));
+    header.version = COMPRESSED_TEXTURE_VERSION;
+    header.format = image.format;
+    header.width = image.width;
+    header.height = image.height;
+    header.levels = static_cast<uint32_t>(image.levels.size());
+    if (!StampFile(imagePath, header.source, true))
+        return false;
+
+    std::vector<uint64_t> sizes;
+    for (const std::vector<uint8_t>& level : image.levels)
+        sizes.push_back(level.size());
+
+    std::string cachePath = CompressedTexturePath(imagePath);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Cannot write texture cache: " << tempPath << "\n";
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(sizes.data()), sizes.size() * sizeof(uint64_t));
+
+        static const char zeros[COOKED_ALIGNMENT] = {};
+        for (const std::vector<uint8_t>& level : image.levels) {
+            uint64_t pos = static_cast<uint64_t>(out.tellp());
+            uint64_t aligned = (pos + COOKED_ALIGNMENT - 1) & ~(COOKED_ALIGNMENT - 1);
+            out.write(zeros, static_cast<std::streamsize>(aligned - pos));
+            out.write(reinterpret_cast<const char*>(level.data()), static_cast<std::streamsize>(level.size()));
+        }
+        if (!out)
+            return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+// Compressed mip chain of the image at path, from the .bc cache if it is still valid
+bool LoadCompressedTexture(const std::string& path, CompressedImage& image, ThreadPool* workers)
+{
+    if (LoadCompressedCache(path, image))
+        return true;
+
+    stbi_set_flip_vertically_on_load(true); // flip v coord for opengl
+    int width, height, channels;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4); // force RGBA
+    if (!data)
+        return false;
+
+    CompressImage(data, width, height, INT32_MAX, image, workers);
+    stbi_image_free(data);
+
+    if (!WriteCompressedCache(path, image))
+        std::cerr << "Could not write texture cache for " << path << "\n";
+    return true;
+}
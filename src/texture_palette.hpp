@@ -0,0 +1,451 @@
+// Palettized (CLUT) textures
+//
+// Like PS1 textures, an image is stored as 4 bit (16 colors) or 8 bit (256
+// colors) indices into a color lookup table. The palette comes from a weighted
+// median cut over the image's unique colors (RGBA, so alpha cut-outs keep their
+// own entries); every pixel is then mapped to its nearest palette entry, 4
+// entries per step with SSE2.
+//
+// Mip levels are box filtered in RGBA and mapped to the same palette, averaging
+// indices would be meaningless. The GPU samples them with nearest filtering.
+//
+// The result is cached as "<image>.clut" next to the source (indices packed two
+// per byte for 16 colors):
+//
+//   PalettizedHeader
+//   uint32 palette[colors] (RGBA8)
+//   level payloads, each aligned to COOKED_ALIGNMENT
+//
+// Image files are validated with the cooked mesh cache stamps, in-memory
+// images (atlas pages) by the hash of their pixels.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+#include "stb_image.h"
+#include "texture_compression.hpp"
+#include "thread_pool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define PALETTE_SSE 1
+#endif
+
+const char PALETTIZED_MAGIC[8] = { 'P', 'S', 'X', 'C', 'L', 'U', 'T', '\0' };
+const uint32_t PALETTIZED_VERSION = 1;
+const int PALETTE_MAX_COLORS = 256;
+
+struct PalettizedHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t colors; // 16 or 256
+    int32_t width, height;
+    uint32_t levels;
+    uint32_t pad;
+    CookedSourceStamp source; // file stamp, or size + hash of the pixels
+};
+
+// Index mip chain + palette of one image, one index byte per texel in memory
+struct PalettizedImage {
+    int width = 0, height = 0;
+    int colors = 0;
+    std::vector<uint32_t> palette; // RGBA8, colors entries (unused ones black)
+    std::vector<std::vector<uint8_t>> levels;
+};
+
+std::string PalettizedTexturePath(const std::string& imagePath)
+{
+    return imagePath + ".clut";
+}
+
+inline uint32_t PackRGBA(const uint8_t* p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+inline uint8_t ColorChannel(uint32_t color, int channel)
+{
+    return static_cast<uint8_t>(color >> (channel * 8));
+}
+
+// Weighted median cut over the unique colors of count RGBA pixels
+void MedianCutPalette(const uint8_t* rgba, size_t count, int colors, std::vector<uint32_t>& palette)
+{
+    struct ColorCount {
+        uint32_t color;
+        uint32_t count;
+    };
+    struct Box {
+        size_t begin, end;
+        int channel = 0, range = 0; // widest channel and its extent
+    };
+
+    std::unordered_map<uint32_t, uint32_t> histogram;
+    for (size_t i = 0; i < count; i++)
+        histogram[PackRGBA(&rgba[i * 4])]++;
+    std::vector<ColorCount> unique;
+    unique.reserve(histogram.size());
+    for (const auto& entry : histogram)
+        unique.push_back({ entry.first, entry.second });
+
+    palette.assign(colors, 0xFF000000u);
+    if (unique.size() <= size_t(colors)) {
+        for (size_t i = 0; i < unique.size(); i++)
+            palette[i] = unique[i].color;
+        return;
+    }
+
+    auto measure = [&](Box& box) {
+        int lo[4] = { 255, 255, 255, 255 }, hi[4] = { 0, 0, 0, 0 };
+        for (size_t i = box.begin; i < box.end; i++)
+            for (int c = 0; c < 4; c++) {
+                lo[c] = std::min<int>(lo[c], ColorChannel(unique[i].color, c));
+                hi[c] = std::max<int>(hi[c], ColorChannel(unique[i].color, c));
+            }
+        box.range = -1;
+        for (int c = 0; c < 4; c++)
+            if (hi[c] - lo[c] > box.range) {
+                box.range = hi[c] - lo[c];
+                box.channel = c;
+            }
+    };
+
+    std::vector<Box> boxes(1, Box{ 0, unique.size() });
+    measure(boxes[0]);
+    while (boxes.size() < size_t(colors)) {
+        // split the box with the widest channel
+        size_t split = SIZE_MAX;
+        for (size_t b = 0; b < boxes.size(); b++)
+            if (boxes[b].end - boxes[b].begin > 1 && (split == SIZE_MAX || boxes[b].range > boxes[split].range))
+                split = b;
+        if (split == SIZE_MAX || boxes[split].range == 0)
+            break;
+
+        Box& box = boxes[split];
+        int channel = box.channel;
+        std::sort(unique.begin() + box.begin, unique.begin() + box.end, [channel](const ColorCount& a, const ColorCount& b) {
+            return ColorChannel(a.color, channel) < ColorChannel(b.color, channel);
+        });
+
+        // weighted median, both halves non-empty
+        uint64_t total = 0, half = 0;
+        for (size_t i = box.begin; i < box.end; i++)
+            total += unique[i].count;
+        size_t mid = box.begin;
+        while (mid < box.end - 1 && (half + unique[mid].count) * 2 <= total)
+            half += unique[mid++].count;
+        mid = std::max(mid, box.begin + 1);
+
+        Box upper{ mid, box.end };
+        box.end = mid;
+        measure(box);
+        measure(upper);
+        boxes.push_back(upper);
+    }
+
+    for (size_t b = 0; b < boxes.size(); b++) {
+        uint64_t sum[4] = {}, weight = 0;
+        for (size_t i = boxes[b].begin; i < boxes[b].end; i++) {
+            for (int c = 0; c < 4; c++)
+                sum[c] += uint64_t(ColorChannel(unique[i].color, c)) * unique[i].count;
+            weight += unique[i].count;
+        }
+        uint8_t mean[4];
+        for (int c = 0; c < 4; c++)
+            mean[c] = static_cast<uint8_t>((sum[c] + weight / 2) / weight);
+        palette[b] = PackRGBA(mean);
+    }
+}
+
+// Palette as interleaved int16 (r, g) and (b, a) pairs, padded to a multiple of
+// 4 entries with copies of the last one (a later copy never wins a tie)
+struct PaletteSearch {
+    std::vector<int16_t> rg, ba;
+    std::vector<uint32_t> colors;
+    int count = 0;
+
+    void build(const std::vector<uint32_t>& palette, int used)
+    {
+        count = used;
+        colors.assign(palette.begin(), palette.begin() + used);
+        int padded = (used + 3) & ~3;
+        rg.resize(padded * 2);
+        ba.resize(padded * 2);
+        for (int i = 0; i < padded; i++) {
+            uint32_t c = palette[std::min(i, used - 1)];
+            rg[i * 2] = ColorChannel(c, 0);
+            rg[i * 2 + 1] = ColorChannel(c, 1);
+            ba[i * 2] = ColorChannel(c, 2);
+            ba[i * 2 + 1] = ColorChannel(c, 3);
+        }
+    }
+
+    uint8_t nearestScalar(const uint8_t* p) const
+    {
+        int best = 0, bestDist = INT32_MAX;
+        for (int i = 0; i < count; i++) {
+            int dr = rg[i * 2] - p[0], dg = rg[i * 2 + 1] - p[1], db = ba[i * 2] - p[2], da = ba[i * 2 + 1] - p[3];
+            int dist = dr * dr + dg * dg + db * db + da * da;
+            if (dist < bestDist) {
+                bestDist = dist;
+                best = i;
+            }
+        }
+        return static_cast<uint8_t>(best);
+    }
+
+#if defined(PALETTE_SSE)
+    // squared distances of 4 entries per step: madd of (dr, dg) and (db, da) pairs
+    uint8_t nearest(const uint8_t* p) const
+    {
+        const __m128i pixelRG = _mm_set1_epi32(int(p[0]) | (int(p[1]) << 16));
+        const __m128i pixelBA = _mm_set1_epi32(int(p[2]) | (int(p[3]) << 16));
+        __m128i bestDist = _mm_set1_epi32(INT32_MAX);
+        __m128i bestIndex = _mm_setzero_si128();
+        __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+        const __m128i four = _mm_set1_epi32(4);
+
+        for (size_t i = 0; i < rg.size(); i += 8) {
+            __m128i drg = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&rg[i])), pixelRG);
+            __m128i dba = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&ba[i])), pixelBA);
+            __m128i dist = _mm_add_epi32(_mm_madd_epi16(drg, drg), _mm_madd_epi16(dba, dba));
+            __m128i closer = _mm_cmplt_epi32(dist, bestDist);
+            bestDist = _mm_or_si128(_mm_and_si128(closer, dist), _mm_andnot_si128(closer, bestDist));
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, bestIndex));
+            index = _mm_add_epi32(index, four);
+        }
+
+        alignas(16) int32_t dists[4], indices[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(dists), bestDist);
+        _mm_store_si128(reinterpret_cast<__m128i*>(indices), bestIndex);
+        int best = 0;
+        for (int lane = 1; lane < 4; lane++)
+            if (dists[lane] < dists[best] || (dists[lane] == dists[best] && indices[lane] < indices[best]))
+                best = lane;
+        return static_cast<uint8_t>(indices[best]);
+    }
+#else
+    uint8_t nearest(const uint8_t* p) const { return nearestScalar(p); }
+#endif
+};
+
+// Indices of width x height RGBA pixels, rows in parallel on workers (if any)
+void RemapToPalette(const uint8_t* rgba, int width, int height, const PaletteSearch& search,
+                    std::vector<uint8_t>& indices, ThreadPool* workers)
+{
+    indices.resize(size_t(width) * height);
+    auto remapRow = [&](size_t y) {
+        const uint8_t* row = &rgba[y * width * 4];
+        uint8_t* out = &indices[y * width];
+        uint32_t lastColor = 0;
+        uint8_t lastIndex = 0;
+        bool haveLast = false;
+        for (int x = 0; x < width; x++) {
+            // runs of the same color are common in PS1 scale art
+            uint32_t color = PackRGBA(&row[x * 4]);
+            if (!haveLast || color != lastColor) {
+                lastIndex = search.nearest(&row[x * 4]);
+                lastColor = color;
+                haveLast = true;
+            }
+            out[x] = lastIndex;
+        }
+    };
+
+    if (workers)
+        workers->parallelFor(height, remapRow);
+    else
+        for (int y = 0; y < height; y++)
+            remapRow(y);
+}
+
+// Palette + index mip chain (maxLevels) of an RGBA8 image, colors 16 or 256
+void PalettizeImage(const uint8_t* rgba, int width, int height, int maxLevels, int colors,
+                    PalettizedImage& image, ThreadPool* workers)
+{
+    image.width = width;
+    image.height = height;
+    image.colors = colors;
+    MedianCutPalette(rgba, size_t(width) * height, colors, image.palette);
+
+    PaletteSearch search;
+    search.build(image.palette, colors);
+
+    image.levels.clear();
+    std::vector<uint8_t> level(rgba, rgba + size_t(width) * height * 4), next;
+    int w = width, h = height;
+    for (int l = 0; l < maxLevels; l++) {
+        image.levels.emplace_back();
+        RemapToPalette(level.data(), w, h, search, image.levels.back(), workers);
+        if (w == 1 && h == 1)
+            break;
+        DownsampleRGBA(level.data(), w, h, next);
+        level.swap(next);
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+}
+
+// 16 color levels are stored two indices per byte, low nibble first
+size_t PalettizedLevelBytes(int colors, int width, int height)
+{
+    size_t texels = size_t(std::max(1, width)) * std::max(1, height);
+    return colors <= 16 ? (texels + 1) / 2 : texels;
+}
+
+bool LoadPalettizedCache(const std::string& cachePath, int colors, const CookedSourceStamp* memoryStamp,
+                         const std::string& sourcePath, PalettizedImage& image)
+{
+    MappedFile file;
+    if (!file.open(cachePath) || file.size < sizeof(PalettizedHeader))
+        return false;
+
+    PalettizedHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+    if (std::memcmp(header.magic, PALETTIZED_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != PALETTIZED_VERSION || header.colors != uint32_t(colors) ||
+        !CookedTextureSizeValid(header.width, header.height, header.levels))
+        return false;
+    CookedSourceStamp source = header.source;
+    if (memoryStamp ? (header.source.size != memoryStamp->size || header.source.hash != memoryStamp->hash)
+                    : (!StampStillValid(sourcePath, header.source, &source) ||
+                       !CookedTextureMatchesSource(sourcePath, header.width, header.height)))
+        return false;
+
+    size_t offset = sizeof(header);
+    if (file.size < offset + colors * sizeof(uint32_t))
+        return false;
+    image.width = header.width;
+    image.height = header.height;
+    image.colors = colors;
+    image.palette.resize(colors);
+    std::memcpy(image.palette.data(), file.data + offset, colors * sizeof(uint32_t));
+    offset += colors * sizeof(uint32_t);
+
+    image.levels.resize(header.levels);
+    for (uint32_t l = 0; l < header.levels; l++) {
+        int w = std::max(1, header.width >> l), h = std::max(1, header.height >> l);
+        size_t bytes = PalettizedLevelBytes(colors, w, h);
+        offset = (offset + COOKED_ALIGNMENT - 1) & ~(COOKED_ALIGNMENT - 1);
+        if (offset + bytes > file.size)
+            return false;
+
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(file.data + offset);
+        std::vector<uint8_t>& level = image.levels[l];
+        if (colors <= 16) {
+            level.resize(size_t(w) * h);
+            for (size_t i = 0; i < level.size(); i++)
+                level[i] = (src[i / 2] >> ((i & 1) * 4)) & 0x0F;
+        } else {
+            level.assign(src, src + bytes);
+        }
+        offset += bytes;
+    }
+
+    if (source.mtime != header.source.mtime) {
+        file.close();
+        RefreshCookedStamp(cachePath, offsetof(PalettizedHeader, source), source);
+    }
+    return true;
+}
+
+bool WritePalettizedCache(const std::string& cachePath, const CookedSourceStamp& source, const PalettizedImage& image)
+{
+    PalettizedHeader header = {};
+    std::memcpy(header.magic, PALETTIZED_MAGIC, sizeof(header.magic));
+    header.version = PALETTIZED_VERSION;
+    header.colors = image.colors;
+    header.width = image.width;
+    header.height = image.height;
+    header.levels = static_cast<uint32_t>(image.levels.size());
+    header.source = source;
+
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Cannot write texture cache: " << tempPath << "\n";
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(image.palette.data()), image.palette.size() * sizeof(uint32_t));
+
+        static const char zeros[COOKED_ALIGNMENT] = {};
+        std::vector<uint8_t> packed;
+        for (const std::vector<uint8_t>& level : image.levels) {
+            uint64_t pos = static_cast<uint64_t>(out.tellp());
+            uint64_t aligned = (pos + COOKED_ALIGNMENT - 1) & ~(COOKED_ALIGNMENT - 1);
+            out.write(zeros, static_cast<std::streamsize>(aligned - pos));
+
+            const std::vector<uint8_t>* payload = &level;
+            if (image.colors <= 16) {
+                packed.assign((level.size() + 1) / 2, 0);
+                for (size_t i = 0; i < level.size(); i++)
+                    packed[i / 2] |= static_cast<uint8_t>((level[i] & 0x0F) << ((i & 1) * 4));
+                payload = &packed;
+            }
+            out.write(reinterpret_cast<const char*>(payload->data()), static_cast<std::streamsize>(payload->size()));
+        }
+        if (!out)
+            return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+// Palettized mip chain of the image file at path, from the .clut cache if it is still valid
+bool LoadPalettizedTexture(const std::string& path, int colors, PalettizedImage& image, ThreadPool* workers)
+{
+    std::string cachePath = PalettizedTexturePath(path);
+    if (LoadPalettizedCache(cachePath, colors, nullptr, path, image))
+        return true;
+
+    stbi_set_flip_vertically_on_load(true); // flip v coord for opengl
+    int width, height, channels;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4); // force RGBA
+    if (!data)
+        return false;
+
+    PalettizeImage(data, width, height, TextureMipLevels(width, height), colors, image, workers);
+    stbi_image_free(data);
+
+    CookedSourceStamp stamp;
+    if (!StampFile(path, stamp, true) || !WritePalettizedCache(cachePath, stamp, image))
+        std::cerr << "Could not write texture cache for " << path << "\n";
+    return true;
+}
+
+// Same for an in-memory RGBA8 image, cached as "<key>.clut" by content hash
+void PalettizeMemoryImage(const std::string& key, const uint8_t* rgba, int width, int height, int levels,
+                          int colors, PalettizedImage& image, ThreadPool* workers)
+{
+    CookedSourceStamp stamp;
+    stamp.size = size_t(width) * height * 4;
+    stamp.hash = HashBytes(reinterpret_cast<const char*>(rgba), stamp.size);
+
+    std::string cachePath = PalettizedTexturePath(key);
+    if (LoadPalettizedCache(cachePath, colors, &stamp, key, image) && image.width == width &&
+        image.height == height && int(image.levels.size()) == levels)
+        return;
+
+    PalettizeImage(rgba, width, height, levels, colors, image, workers);
+    if (!WritePalettizedCache(cachePath, stamp, image))
+        std::cerr << "Could not write texture cache for " << key << "\n";
+}
@@ -0,0 +1,506 @@
+// Texture arrays shared by all materials
+//
+// Textures are grouped by size and format into GL_TEXTURE_2D_ARRAY objects; a
+// material references its texture as (array, layer). Everything in one array is
+// bound once, the layer is passed per draw, so objects with different textures
+// of the same size batch into the same calls.
+//
+// Layers are reference counted like GpuMeshes; a freed layer is reused by the
+// next texture of that size. Array capacity is picked from a byte budget so
+// large textures do not reserve dozens of layers up front.
+//
+// Besides image files the pool serves in-memory images registered with
+// setImage (atlas pages); they are uploaded again when they change.
+//
+// storage picks how textures are kept on the GPU:
+//   TEXTURE_RGBA8          as loaded
+//   TEXTURE_RGB16          RGB565, or RGBA5551 if the image has alpha, converted
+//                          (and dithered) at load (texture_color16.hpp)
+//   TEXTURE_BC             BC1 / BC3 (texture_compression.hpp), image files
+//                          through the .bc disk cache
+//   TEXTURE_CLUT4 / CLUT8  GL_R8 palette indices (texture_palette.hpp), the
+//                          palette is one row of the shared CLUT texture and the
+//                          fragment shader looks the color up
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "stb_image.h"
+#include "texture_color16.hpp"
+#include "texture_compression.hpp"
+#include "texture_palette.hpp"
+#include "thread_pool.hpp"
+
+enum TextureStorage {
+    TEXTURE_RGBA8,
+    TEXTURE_RGB16,
+    TEXTURE_BC,    // needs EXT_texture_compression_s3tc
+    TEXTURE_CLUT4, // 16 colors
+    TEXTURE_CLUT8, // 256 colors
+};
+
+const GLint CLUT_TEXTURE_UNIT = 2;
+const int CLUT_INITIAL_ROWS = 64;
+
+struct TextureRef {
+    uint16_t array = UINT16_MAX;
+    uint16_t layer = 0;
+    int16_t clut = -1; // CLUT row of a palettized texture, -1 = color texture
+
+    bool valid() const { return array != UINT16_MAX; }
+};
+
+struct TextureArray {
+    GLuint texture = 0;
+    int width = 0, height = 0;
+    GLenum internalFormat = GL_RGBA8;
+    int levels = 1;
+    int capacity = 0;                  // layers
+    std::vector<unsigned int> refCounts; // per layer, 0 = free
+    std::vector<std::string> keys;       // per layer
+    std::vector<int16_t> cluts;          // per layer, CLUT row or -1
+
+    int used() const { return static_cast<int>(std::count_if(refCounts.begin(), refCounts.end(), [](unsigned int c) { return c > 0; })); }
+
+    // GPU memory including the mip chain
+    size_t bytes() const
+    {
+        size_t total = 0;
+        for (int level = 0; level < levels; level++)
+            total += TextureLevelBytes(internalFormat, width >> level, height >> level);
+        return total * capacity;
+    }
+};
+
+// RGBA8 image registered under a key instead of a file
+struct MemoryImage {
+    int width = 0, height = 0;
+    int levels = 0; // mip levels, 0 = full chain
+    std::vector<uint8_t> pixels;
+};
+
+struct TexturePool {
+    std::vector<TextureArray> arrays;
+    std::unordered_map<std::string, TextureRef> byPath;
+    std::unordered_map<std::string, MemoryImage> images;
+    size_t arrayBudgetBytes = 16u << 20; // per array, sets the layer capacity
+    int maxLayers = 64;
+    TextureStorage storage = TEXTURE_RGBA8;
+    ThreadPool* workers = nullptr;       // encodes rows / textures in parallel if set
+    bool dither16 = true;                // ordered dither for TEXTURE_RGB16
+    GLenum opaque16Format = GL_RGB565;   // GL_RGB5 without GL 4.1 / ARB_ES2_compatibility
+
+    // palettes, PALETTE_MAX_COLORS x clutCapacity RGBA8
+    GLuint clutTexture = 0;
+    int clutCapacity = 0;
+    std::vector<uint32_t> clutPixels;
+    std::vector<uint8_t> clutUsed;       // per row
+    std::unordered_map<std::string, PalettizedImage> prefetched; // see prefetch
+
+    bool palettized() const { return storage == TEXTURE_CLUT4 || storage == TEXTURE_CLUT8; }
+    int paletteColors() const { return storage == TEXTURE_CLUT4 ? 16 : PALETTE_MAX_COLORS; }
+
+    TextureRef acquire(const std::string& path)
+    {
+        auto it = byPath.find(path);
+        if (it != byPath.end()) {
+            arrays[it->second.array].refCounts[it->second.layer]++;
+            return it->second;
+        }
+
+        auto image = images.find(path);
+        if (image != images.end()) {
+            const MemoryImage& m = image->second;
+            return upload(path, m.width, m.height, m.levels, m.pixels.data());
+        }
+
+        if (palettized()) {
+            PalettizedImage indexed;
+            if (!takePrefetched(path, indexed) && !LoadPalettizedTexture(path, paletteColors(), indexed, workers)) {
+                std::cerr << "TexturePool: failed to load texture " << path << "\n";
+                return TextureRef{};
+            }
+            return uploadPalettized(path, indexed);
+        }
+
+        if (storage == TEXTURE_BC) {
+            CompressedImage compressed;
+            if (!LoadCompressedTexture(path, compressed, workers)) {
+                std::cerr << "TexturePool: failed to load texture " << path << "\n";
+                return TextureRef{};
+            }
+            return uploadCompressed(path, compressed);
+        }
+
+        stbi_set_flip_vertically_on_load(true); // flip v coord for opengl
+        int width, height, channels;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4); // force RGBA
+        if (!data) {
+            std::cerr << "TexturePool: failed to load texture " << path << "\n";
+            return TextureRef{};
+        }
+
+        TextureRef ref = upload(path, width, height, 0, data);
+        stbi_image_free(data);
+        return ref;
+    }
+
+    // Quantize the given textures (paths as passed to acquire) in parallel, one
+    // texture per job, so their acquire only uploads. Only used by the CLUT modes.
+    void prefetch(const std::vector<std::string>& paths)
+    {
+        if (!palettized())
+            return;
+
+        std::vector<std::string> pending;
+        for (const std::string& path : paths)
+            if (!byPath.count(path) && !prefetched.count(path) &&
+                std::find(pending.begin(), pending.end(), path) == pending.end())
+                pending.push_back(path);
+
+        std::vector<PalettizedImage> results(pending.size());
+        std::vector<uint8_t> loaded(pending.size(), 0);
+        auto job = [&](size_t i) {
+            // no nested parallelFor from inside a job, rows run serially
+            auto image = images.find(pending[i]);
+            if (image != images.end()) {
+                const MemoryImage& m = image->second;
+                int levels = m.levels > 0 ? m.levels : TextureMipLevels(m.width, m.height);
+                PalettizeMemoryImage(pending[i], m.pixels.data(), m.width, m.height, levels, paletteColors(), results[i], nullptr);
+                loaded[i] = 1;
+            } else {
+                loaded[i] = LoadPalettizedTexture(pending[i], paletteColors(), results[i], nullptr);
+            }
+        };
+        if (workers)
+            workers->parallelFor(pending.size(), job);
+        else
+            for (size_t i = 0; i < pending.size(); i++)
+                job(i);
+
+        for (size_t i = 0; i < pending.size(); i++)
+            if (loaded[i])
+                prefetched[pending[i]] = std::move(results[i]);
+    }
+
+    bool takePrefetched(const std::string& path, PalettizedImage& image)
+    {
+        auto it = prefetched.find(path);
+        if (it == prefetched.end())
+            return false;
+        image = std::move(it->second);
+        prefetched.erase(it);
+        return true;
+    }
+
+    // New layer for path, holding one reference
+    TextureRef addLayer(const std::string& path, int width, int height, GLenum internalFormat, int levels)
+    {
+        TextureRef ref = allocateLayer(width, height, internalFormat, levels);
+        TextureArray& array = arrays[ref.array];
+        array.refCounts[ref.layer] = 1;
+        array.keys[ref.layer] = path;
+        byPath[path] = ref;
+        return ref;
+    }
+
+    TextureRef upload(const std::string& path, int width, int height, int levels, const uint8_t* rgba)
+    {
+        if (levels <= 0)
+            levels = TextureMipLevels(width, height);
+
+        if (palettized()) {
+            PalettizedImage indexed;
+            if (!takePrefetched(path, indexed))
+                PalettizeMemoryImage(path, rgba, width, height, levels, paletteColors(), indexed, workers);
+            return uploadPalettized(path, indexed);
+        }
+        if (storage == TEXTURE_BC) {
+            CompressedImage compressed;
+            CompressImage(rgba, width, height, levels, compressed, workers);
+            return uploadCompressed(path, compressed);
+        }
+        if (storage == TEXTURE_RGB16) {
+            bool alpha = ImageHasAlpha(rgba, size_t(width) * height);
+            TextureRef ref = addLayer(path, width, height, alpha ? GL_RGB5_A1 : opaque16Format, levels);
+            writeLayer(ref, rgba);
+            return ref;
+        }
+
+        TextureRef ref = addLayer(path, width, height, GL_RGBA8, levels);
+        writeLayer(ref, rgba);
+        return ref;
+    }
+
+    TextureRef uploadCompressed(const std::string& path, const CompressedImage& image)
+    {
+        TextureRef ref = addLayer(path, image.width, image.height, image.format, static_cast<int>(image.levels.size()));
+        writeCompressedLayer(ref, image);
+        return ref;
+    }
+
+    TextureRef uploadPalettized(const std::string& path, const PalettizedImage& image)
+    {
+        TextureRef ref = addLayer(path, image.width, image.height, GL_R8, static_cast<int>(image.levels.size()));
+        ref.clut = allocateClutRow();
+        arrays[ref.array].cluts[ref.layer] = ref.clut;
+        byPath[path] = ref;
+        writePalettizedLayer(ref, image);
+        return ref;
+    }
+
+    void writeCompressedLayer(TextureRef ref, const CompressedImage& image)
+    {
+        const TextureArray& array = arrays[ref.array];
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        for (int level = 0; level < array.levels; level++)
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, ref.layer,
+                                      std::max(1, image.width >> level), std::max(1, image.height >> level), 1,
+                                      image.format, static_cast<GLsizei>(image.levels[level].size()),
+                                      image.levels[level].data());
+    }
+
+    void writePalettizedLayer(TextureRef ref, const PalettizedImage& image)
+    {
+        const TextureArray& array = arrays[ref.array];
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // index rows are not 4 byte aligned
+        for (int level = 0; level < array.levels; level++)
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, ref.layer,
+                            std::max(1, image.width >> level), std::max(1, image.height >> level), 1,
+                            GL_RED, GL_UNSIGNED_BYTE, image.levels[level].data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        setClutRow(ref.clut, image.palette);
+    }
+
+    // Mip chain built from RGBA8, every level converted to the array's 16 bit format
+    void writeColor16Layer(TextureRef ref, const uint8_t* rgba)
+    {
+        const TextureArray& array = arrays[ref.array];
+        bool alpha = array.internalFormat == GL_RGB5_A1;
+        std::vector<uint8_t> level(rgba, rgba + size_t(array.width) * array.height * 4), next;
+        std::vector<uint16_t> texels;
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        int w = array.width, h = array.height;
+        for (int l = 0; l < array.levels; l++) {
+            ConvertImageColor16(level.data(), w, h, alpha, dither16, texels);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, ref.layer, w, h, 1, alpha ? GL_RGBA : GL_RGB,
+                            alpha ? GL_UNSIGNED_SHORT_5_5_5_1 : GL_UNSIGNED_SHORT_5_6_5, texels.data());
+            if (l + 1 < array.levels) {
+                DownsampleRGBA(level.data(), w, h, next);
+                level.swap(next);
+                w = std::max(1, w / 2);
+                h = std::max(1, h / 2);
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // Replace the pixels of a resident layer, encoded like the array
+    void writeLayer(TextureRef ref, const uint8_t* rgba)
+    {
+        const TextureArray& array = arrays[ref.array];
+        if (IsColor16Format(array.internalFormat)) {
+            writeColor16Layer(ref, rgba);
+            return;
+        }
+        if (array.internalFormat == GL_R8) {
+            PalettizedImage indexed;
+            PalettizeMemoryImage(array.keys[ref.layer], rgba, array.width, array.height, array.levels,
+                                 paletteColors(), indexed, workers);
+            writePalettizedLayer(ref, indexed);
+            return;
+        }
+        if (IsCompressedFormat(array.internalFormat)) {
+            // same format as the array, even if the alpha changed
+            CompressedImage compressed;
+            CompressImage(rgba, array.width, array.height, array.levels, compressed, workers, array.internalFormat);
+            writeCompressedLayer(ref, compressed);
+            return;
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, ref.layer, array.width, array.height, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+
+    // Register or replace an in-memory image, a resident copy is updated
+    void setImage(const std::string& key, int width, int height, int levels, const uint8_t* rgba)
+    {
+        MemoryImage& image = images[key];
+        image.width = width;
+        image.height = height;
+        image.levels = levels;
+        image.pixels.assign(rgba, rgba + size_t(width) * height * 4);
+        prefetched.erase(key);
+
+        auto it = byPath.find(key);
+        if (it != byPath.end())
+            writeLayer(it->second, image.pixels.data());
+    }
+
+    void release(TextureRef& ref)
+    {
+        if (!ref.valid())
+            return;
+        TextureArray& array = arrays[ref.array];
+        unsigned int& count = array.refCounts[ref.layer];
+        if (count == 0) {
+            std::cerr << "TexturePool: release of unreferenced layer " << ref.layer << "\n";
+        } else if (--count == 0) {
+            byPath.erase(array.keys[ref.layer]);
+            array.keys[ref.layer].clear();
+            if (array.cluts[ref.layer] >= 0)
+                clutUsed[array.cluts[ref.layer]] = 0;
+            array.cluts[ref.layer] = -1;
+        }
+        ref = TextureRef{};
+    }
+
+    // GL name of the array to bind, 0 for an invalid ref
+    GLuint texture(TextureRef ref) const { return ref.valid() ? arrays[ref.array].texture : 0; }
+
+    // Free CLUT row, the texture doubles when all are taken
+    int16_t allocateClutRow()
+    {
+        for (int row = 0; row < clutCapacity; row++)
+            if (!clutUsed[row]) {
+                clutUsed[row] = 1;
+                return static_cast<int16_t>(row);
+            }
+
+        int row = clutCapacity;
+        clutCapacity = std::max(CLUT_INITIAL_ROWS, clutCapacity * 2);
+        clutPixels.resize(size_t(clutCapacity) * PALETTE_MAX_COLORS, 0);
+        clutUsed.resize(clutCapacity, 0);
+        clutUsed[row] = 1;
+
+        if (!clutTexture)
+            glGenTextures(1, &clutTexture);
+        glBindTexture(GL_TEXTURE_2D, clutTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, PALETTE_MAX_COLORS, clutCapacity, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, clutPixels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return static_cast<int16_t>(row);
+    }
+
+    void setClutRow(int16_t row, const std::vector<uint32_t>& palette)
+    {
+        uint32_t* dst = &clutPixels[size_t(row) * PALETTE_MAX_COLORS];
+        std::fill(dst, dst + PALETTE_MAX_COLORS, 0u);
+        std::copy(palette.begin(), palette.begin() + std::min<size_t>(palette.size(), PALETTE_MAX_COLORS), dst);
+
+        glBindTexture(GL_TEXTURE_2D, clutTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, PALETTE_MAX_COLORS, 1, GL_RGBA, GL_UNSIGNED_BYTE, dst);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // CLUT texture on CLUT_TEXTURE_UNIT, leaves unit 0 active
+    void bindClut() const
+    {
+        glActiveTexture(GL_TEXTURE0 + CLUT_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, clutTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // Free layer in an array of this size/format/mip count (0 = full chain),
+    // creating the array if needed
+    TextureRef allocateLayer(int width, int height, GLenum internalFormat, int levels = 0)
+    {
+        int fullLevels = TextureMipLevels(width, height);
+        levels = (levels <= 0) ? fullLevels : std::min(levels, fullLevels);
+
+        for (size_t a = 0; a < arrays.size(); a++) {
+            TextureArray& array = arrays[a];
+            if (array.width != width || array.height != height || array.internalFormat != internalFormat ||
+                array.levels != levels)
+                continue;
+            for (int layer = 0; layer < array.capacity; layer++)
+                if (array.refCounts[layer] == 0)
+                    return TextureRef{ static_cast<uint16_t>(a), static_cast<uint16_t>(layer) };
+        }
+
+        TextureArray array;
+        array.width = width;
+        array.height = height;
+        array.internalFormat = internalFormat;
+        array.levels = levels;
+        array.capacity = 1;
+        size_t layerBytes = array.bytes();
+        array.capacity = static_cast<int>(std::clamp<size_t>(arrayBudgetBytes / layerBytes, 1, maxLayers));
+        array.refCounts.assign(array.capacity, 0);
+        array.keys.resize(array.capacity);
+        array.cluts.assign(array.capacity, -1);
+
+        glGenTextures(1, &array.texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        for (int level = 0; level < array.levels; level++) {
+            int w = std::max(1, width >> level), h = std::max(1, height >> level);
+            if (IsCompressedFormat(internalFormat))
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, w, h, array.capacity, 0,
+                                       static_cast<GLsizei>(TextureLevelBytes(internalFormat, w, h) * array.capacity), nullptr);
+            else
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, w, h, array.capacity,
+                             0, internalFormat == GL_R8 ? GL_RED : GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levels - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        arrays.push_back(std::move(array));
+        return TextureRef{ static_cast<uint16_t>(arrays.size() - 1), 0 };
+    }
+
+    void destroy()
+    {
+        for (TextureArray& array : arrays)
+            glDeleteTextures(1, &array.texture);
+        if (clutTexture)
+            glDeleteTextures(1, &clutTexture);
+        clutTexture = 0;
+        clutCapacity = 0;
+        clutPixels.clear();
+        clutUsed.clear();
+        arrays.clear();
+        byPath.clear();
+        images.clear();
+        prefetched.clear();
+    }
+
+    void printStats() const
+    {
+        size_t total = 0;
+        for (const TextureArray& array : arrays)
+            total += array.bytes();
+        total += clutPixels.size() * sizeof(uint32_t);
+        std::cout << "Texture pool: " << arrays.size() << " arrays, " << byPath.size()
+                  << " textures, " << total / 1024 << " KiB\n";
+        for (size_t a = 0; a < arrays.size(); a++) {
+            const TextureArray& array = arrays[a];
+            const char* format = array.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? "BC1"
+                               : array.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? "BC3"
+                               : array.internalFormat == GL_R8 ? "CLUT indices"
+                               : array.internalFormat == GL_RGB5_A1 ? "RGBA5551"
+                               : IsColor16Format(array.internalFormat) ? "RGB565" : "RGBA8";
+            std::cout << "  array " << a << ": " << array.width << "x" << array.height << " " << format
+                      << ", " << array.used() << "/" << array.capacity << " layers, "
+                      << array.bytes() / 1024 << " KiB\n";
+        }
+        if (clutCapacity)
+            std::cout << "  CLUT: " << std::count(clutUsed.begin(), clutUsed.end(), 1) << "/" << clutCapacity
+                      << " palettes of " << paletteColors() << " colors\n";
+    }
+};
@@ -0,0 +1,115 @@
+// Persistent worker threads for per frame jobs
+//
+// parallelFor hands out job indices through an atomic counter; the calling
+// thread works on the job too and returns once every index is done. The
+// workers sleep on a condition variable between jobs, so there is no thread
+// creation per frame.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+
+    std::function<void(size_t)> job;
+    size_t jobCount = 0;
+    std::atomic<size_t> nextIndex{ 0 };
+    uint64_t generation = 0;   // bumped per parallelFor
+    unsigned int busy = 0;     // workers still on the current generation
+    bool stopping = false;
+
+    ThreadPool() = default;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool() { stop(); }
+
+    // threadCount includes the calling thread, 0 = one per hardware thread
+    void start(unsigned int threadCount = 0)
+    {
+        stop();
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        stopping = false;
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        workers.clear();
+    }
+
+    size_t threadCount() const { return workers.size() + 1; }
+
+    // Run fn(i) for i in [0, count), blocks until all are done
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn)
+    {
+        if (count == 0)
+            return;
+        if (workers.empty() || count == 1) {
+            for (size_t i = 0; i < count; i++)
+                fn(i);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = fn;
+            jobCount = count;
+            nextIndex.store(0, std::memory_order_relaxed);
+            busy = static_cast<unsigned int>(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        runJob();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+        job = nullptr;
+    }
+
+    void runJob()
+    {
+        for (size_t i = nextIndex.fetch_add(1); i < jobCount; i = nextIndex.fetch_add(1))
+            job(i);
+    }
+
+    void workerLoop()
+    {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+
+            runJob();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy--;
+            }
+            done.notify_one();
+        }
+    }
+};
@@ -0,0 +1,213 @@
+// Interleaved vertex formats
+//
+// A VertexFormat describes one interleaved vertex (position, uv, normal and an
+// optional color) with a component type per attribute. PackVertices writes a
+// Mesh into that layout and ApplyVertexFormat sets the attribute pointers of the
+// bound VAO from the same descriptor, so the two can never disagree.
+//
+// Normalized position types (snorm16, unorm16, 10_10_10_2) are quantized against
+// the mesh bounds; the returned decode matrix maps them back to object space and
+// has to be multiplied into the model matrix.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "mesh.hpp"
+
+enum VertexComponentType {
+    VERTEX_FLOAT,
+    VERTEX_HALF,
+    VERTEX_SNORM16,
+    VERTEX_UNORM16,
+    VERTEX_PACKED_10_10_10_2, // signed normalized, xyz + 2 bit w in one uint32
+};
+
+// Also the shader attribute locations (3-6 are the instance matrix)
+enum VertexAttribute {
+    ATTRIB_POSITION = 0,
+    ATTRIB_TEXCOORD = 1,
+    ATTRIB_NORMAL = 2,
+    ATTRIB_COLOR = 7,
+};
+
+const int VERTEX_ATTRIBUTE_SLOTS = 4; // position, texcoord, normal, color
+const VertexAttribute VERTEX_ATTRIBUTE_LOCATIONS[VERTEX_ATTRIBUTE_SLOTS] = {
+    ATTRIB_POSITION, ATTRIB_TEXCOORD, ATTRIB_NORMAL, ATTRIB_COLOR
+};
+const int VERTEX_ATTRIBUTE_COMPONENTS[VERTEX_ATTRIBUTE_SLOTS] = { 3, 2, 3, 4 };
+
+struct VertexAttributeFormat {
+    bool enabled = false;
+    VertexComponentType type = VERTEX_FLOAT;
+    GLuint offset = 0;
+};
+
+struct VertexFormat {
+    VertexAttributeFormat attributes[VERTEX_ATTRIBUTE_SLOTS]; // in slot order
+    GLsizei stride = 0;
+};
+
+// Bytes one attribute takes in the vertex, padded to 4
+GLuint VertexAttributeSize(VertexComponentType type, int components)
+{
+    switch (type) {
+    case VERTEX_FLOAT:             return 4 * components;
+    case VERTEX_PACKED_10_10_10_2: return 4;
+    default:                       return (2 * components + 3) & ~3u; // 16 bit types
+    }
+}
+
+// Builds the descriptor, colorEnabled adds a material color attribute.
+// Packed 10_10_10_2 needs 3+ components and is rejected for texcoords.
+VertexFormat MakeVertexFormat(VertexComponentType position,
+                              VertexComponentType texcoord,
+                              VertexComponentType normal,
+                              bool colorEnabled = false,
+                              VertexComponentType color = VERTEX_UNORM16)
+{
+    if (texcoord == VERTEX_PACKED_10_10_10_2) {
+        std::cerr << "VertexFormat: 10_10_10_2 texcoords not supported, using half\n";
+        texcoord = VERTEX_HALF;
+    }
+
+    VertexFormat format;
+    const VertexComponentType types[VERTEX_ATTRIBUTE_SLOTS] = { position, texcoord, normal, color };
+    const bool enabled[VERTEX_ATTRIBUTE_SLOTS] = { true, true, true, colorEnabled };
+
+    GLuint offset = 0;
+    for (int i = 0; i < VERTEX_ATTRIBUTE_SLOTS; i++) {
+        format.attributes[i].enabled = enabled[i];
+        format.attributes[i].type = types[i];
+        format.attributes[i].offset = offset;
+        if (enabled[i])
+            offset += VertexAttributeSize(types[i], VERTEX_ATTRIBUTE_COMPONENTS[i]);
+    }
+    format.stride = static_cast<GLsizei>(offset);
+    return format;
+}
+
+// 20 bytes: float position, half uv, 10_10_10_2 normal (vs 32 all float)
+VertexFormat DefaultVertexFormat()
+{
+    return MakeVertexFormat(VERTEX_FLOAT, VERTEX_HALF, VERTEX_PACKED_10_10_10_2);
+}
+
+// Write one attribute value (up to 4 components, already in the normalized range
+// for snorm/unorm types) at dst
+void PackAttribute(uint8_t* dst, VertexComponentType type, int components, const glm::vec4& value)
+{
+    switch (type) {
+    case VERTEX_FLOAT:
+        std::memcpy(dst, &value[0], 4 * components);
+        break;
+    case VERTEX_HALF:
+        for (int c = 0; c < components; c++) {
+            uint16_t h = glm::packHalf1x16(value[c]);
+            std::memcpy(dst + 2 * c, &h, 2);
+        }
+        break;
+    case VERTEX_SNORM16:
+        for (int c = 0; c < components; c++) {
+            uint16_t h = glm::packSnorm1x16(value[c]);
+            std::memcpy(dst + 2 * c, &h, 2);
+        }
+        break;
+    case VERTEX_UNORM16:
+        for (int c = 0; c < components; c++) {
+            uint16_t h = glm::packUnorm1x16(value[c]);
+            std::memcpy(dst + 2 * c, &h, 2);
+        }
+        break;
+    case VERTEX_PACKED_10_10_10_2: {
+        glm::vec4 v = value;
+        if (components < 4)
+            v.w = 0.0f;
+        uint32_t packed = glm::packSnorm3x10_1x2(v);
+        std::memcpy(dst, &packed, 4);
+        break;
+    }
+    }
+}
+
+// Interleave mesh into format. Returns the decode matrix for quantized positions
+// (identity for float/half).
+glm::mat4 PackVertices(const Mesh& mesh, const VertexFormat& format, std::vector<uint8_t>& out)
+{
+    const size_t count = mesh.positions.size();
+    out.assign(count * format.stride, 0);
+
+    // Quantization range for normalized position types
+    VertexComponentType posType = format.attributes[0].type;
+    bool signedRange = (posType == VERTEX_SNORM16 || posType == VERTEX_PACKED_10_10_10_2);
+    bool quantized = signedRange || posType == VERTEX_UNORM16;
+
+    glm::vec3 minP = mesh.boundsMin, maxP = mesh.boundsMax;
+    glm::vec3 bias = signedRange ? (minP + maxP) * 0.5f : minP;
+    glm::vec3 scale = signedRange ? (maxP - minP) * 0.5f : (maxP - minP);
+    scale = glm::max(scale, glm::vec3(1e-20f)); // flat meshes
+
+    glm::mat4 decode(1.0f);
+    if (quantized)
+        decode = glm::scale(glm::translate(glm::mat4(1.0f), bias), scale);
+
+    glm::vec4 color(mesh.material.Kd, mesh.material.d);
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* vertex = out.data() + i * format.stride;
+
+        glm::vec3 p = mesh.positions[i];
+        if (quantized)
+            p = (p - bias) / scale;
+        glm::vec4 values[VERTEX_ATTRIBUTE_SLOTS] = {
+            glm::vec4(p, 1.0f),
+            glm::vec4(i < mesh.texcoords.size() ? mesh.texcoords[i] : glm::vec2(0.0f), 0.0f, 0.0f),
+            glm::vec4(i < mesh.normals.size() ? mesh.normals[i] : glm::vec3(0.0f), 0.0f),
+            color,
+        };
+
+        for (int a = 0; a < VERTEX_ATTRIBUTE_SLOTS; a++) {
+            const VertexAttributeFormat& attr = format.attributes[a];
+            if (attr.enabled)
+                PackAttribute(vertex + attr.offset, attr.type, VERTEX_ATTRIBUTE_COMPONENTS[a], values[a]);
+        }
+    }
+    return decode;
+}
+
+// Set the attribute pointers of the bound VAO for the bound GL_ARRAY_BUFFER
+void ApplyVertexFormat(const VertexFormat& format, GLintptr baseOffset = 0)
+{
+    for (int a = 0; a < VERTEX_ATTRIBUTE_SLOTS; a++) {
+        const VertexAttributeFormat& attr = format.attributes[a];
+        GLuint location = VERTEX_ATTRIBUTE_LOCATIONS[a];
+        if (!attr.enabled) {
+            glDisableVertexAttribArray(location);
+            continue;
+        }
+
+        GLint components = VERTEX_ATTRIBUTE_COMPONENTS[a];
+        GLenum glType = GL_FLOAT;
+        GLboolean normalized = GL_FALSE;
+        switch (attr.type) {
+        case VERTEX_FLOAT:   glType = GL_FLOAT; break;
+        case VERTEX_HALF:    glType = GL_HALF_FLOAT; break;
+        case VERTEX_SNORM16: glType = GL_SHORT; normalized = GL_TRUE; break;
+        case VERTEX_UNORM16: glType = GL_UNSIGNED_SHORT; normalized = GL_TRUE; break;
+        case VERTEX_PACKED_10_10_10_2:
+            glType = GL_INT_2_10_10_10_REV;
+            normalized = GL_TRUE;
+            components = 4; // packed types are always read as 4 components
+            break;
+        }
+
+        glVertexAttribPointer(location, components, glType, normalized, format.stride,
+                              (void*)(baseOffset + attr.offset));
+        glEnableVertexAttribArray(location);
+    }
+}
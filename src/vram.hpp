@@ -0,0 +1,502 @@
+// Emulated PS1 VRAM for the software rasterizer
+//
+// 1 MB of 16 bit words, 1024 x 512 like the console's, holding every texture
+// the CPU rasterizer samples when it runs in VRAM mode. Textures are stored
+// the PS1 way: 4 or 8 bit indices packed into words (leftmost texel in the
+// low bits) with a 16 / 256 entry CLUT in a VRAM row, or 15 bit direct color.
+// Colors are PS1 words, 5 bits each of R, G, B from bit 0 up and the STP bit
+// on top; 0x0000 is transparent, so opaque black is stored as 0x8000.
+//
+// Space is handed out first fit in cells of VRAM_CELL x VRAM_CELL words. A
+// texture has to be addressable from one texture page (64 words x 256 lines,
+// u and v are 8 bit), so it never crosses a page row and its texels end
+// within 256 of its page's left edge; larger images are box filtered down
+// first. CLUTs are packed one per line into blocks of cells allocated from
+// the bottom of VRAM up, the display area (two 320x240 framebuffers) is
+// reserved at the top left as on the console.
+//
+// The budget is fixed. A texture that doesn't fit either fails (its draws go
+// untextured until there is room) or evicts the least recently drawn
+// textures not used in the current frame; every texture keeps its packed
+// words in main memory, so an evicted one is uploaded again when it is drawn.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "stb_image.h"
+#include "texture_compression.hpp"
+#include "texture_palette.hpp"
+#include "thread_pool.hpp"
+
+struct VramRect {
+    int x, y, width, height; // in words
+};
+
+const int VRAM_WIDTH = 1024, VRAM_HEIGHT = 512;         // 16 bit words
+const int VRAM_PAGE_WIDTH = 64, VRAM_PAGE_HEIGHT = 256; // texture page, in words
+const int VRAM_PAGE_TEXELS = 256;                       // u, v range from a page's corner
+const int VRAM_CELL = 8;                                // allocation granularity, words
+const int VRAM_CELLS_X = VRAM_WIDTH / VRAM_CELL, VRAM_CELLS_Y = VRAM_HEIGHT / VRAM_CELL;
+const VramRect VRAM_DISPLAY_AREA = { 0, 0, 320, 480 }; // double buffered 320x240
+
+enum VramDepth {
+    VRAM_4BIT,  // 16 color CLUT
+    VRAM_8BIT,  // 256 color CLUT
+    VRAM_15BIT, // direct color
+};
+
+enum VramOverflow {
+    VRAM_FAIL,  // textures that don't fit stay out of VRAM
+    VRAM_EVICT, // least recently drawn textures make room
+};
+
+inline int VramTexelsPerWord(VramDepth depth)
+{
+    return depth == VRAM_4BIT ? 4 : depth == VRAM_8BIT ? 2 : 1;
+}
+
+inline int VramClutColors(VramDepth depth)
+{
+    return depth == VRAM_4BIT ? 16 : depth == VRAM_8BIT ? 256 : 0;
+}
+
+inline uint16_t PackVramColor(int r, int g, int b, int a)
+{
+    if (a < 128)
+        return 0;
+    uint16_t c = static_cast<uint16_t>((r >> 3) | ((g >> 3) << 5) | ((b >> 3) << 10));
+    return c ? c : 0x8000;
+}
+
+inline uint32_t VramColorARGB(uint16_t c)
+{
+    if (c == 0)
+        return 0;
+    uint32_t r = c & 31, g = (c >> 5) & 31, b = (c >> 10) & 31;
+    return 0xFF000000 | (((r << 3) | (r >> 2)) << 16) | (((g << 3) | (g >> 2)) << 8) | ((b << 3) | (b >> 2));
+}
+
+// A resident texture, as the rasterizer samples it
+struct VramTexture {
+    const uint16_t* words = nullptr; // all of VRAM
+    int x = 0, y = 0;                // top left, in words
+    int width = 0, height = 0;       // in texels
+    VramDepth depth = VRAM_4BIT;
+    int clutX = 0, clutY = 0;
+
+    // ARGB of texel (u, v), both inside the texture
+    uint32_t texel(int u, int v) const
+    {
+        const uint16_t* row = words + size_t(y + v) * VRAM_WIDTH + x;
+        const uint16_t* clut = words + size_t(clutY) * VRAM_WIDTH + clutX;
+        if (depth == VRAM_4BIT)
+            return VramColorARGB(clut[(row[u >> 2] >> ((u & 3) * 4)) & 0xF]);
+        if (depth == VRAM_8BIT)
+            return VramColorARGB(clut[(row[u >> 1] >> ((u & 1) * 8)) & 0xFF]);
+        return VramColorARGB(row[u]);
+    }
+};
+
+// First fit over the cell grid, top to bottom (or bottom up), left to right
+struct VramAllocator {
+    std::vector<uint8_t> used = std::vector<uint8_t>(size_t(VRAM_CELLS_X) * VRAM_CELLS_Y, 0);
+
+    bool isFree(int cx, int cy, int cw, int ch) const
+    {
+        for (int y = cy; y < cy + ch; y++)
+            for (int x = cx; x < cx + cw; x++)
+                if (used[size_t(y) * VRAM_CELLS_X + x])
+                    return false;
+        return true;
+    }
+
+    void mark(const VramRect& rect, bool value)
+    {
+        for (int y = rect.y / VRAM_CELL; y < (rect.y + rect.height + VRAM_CELL - 1) / VRAM_CELL; y++)
+            for (int x = rect.x / VRAM_CELL; x < (rect.x + rect.width + VRAM_CELL - 1) / VRAM_CELL; x++)
+                used[size_t(y) * VRAM_CELLS_X + x] = value;
+    }
+
+    // width x height words, rect is the cell rounded area. For a texture
+    // (texelsPerWord > 0) it stays inside one page row and its texelWidth
+    // texels end within VRAM_PAGE_TEXELS of the page's left edge.
+    bool allocate(int width, int height, int texelsPerWord, int texelWidth, bool fromBottom, VramRect& rect)
+    {
+        int cw = (width + VRAM_CELL - 1) / VRAM_CELL, ch = (height + VRAM_CELL - 1) / VRAM_CELL;
+        for (int i = 0; i + ch <= VRAM_CELLS_Y; i++) {
+            int cy = fromBottom ? VRAM_CELLS_Y - ch - i : i;
+            if (texelsPerWord && (cy * VRAM_CELL) % VRAM_PAGE_HEIGHT + height > VRAM_PAGE_HEIGHT)
+                continue;
+            for (int cx = 0; cx + cw <= VRAM_CELLS_X; cx++) {
+                if (texelsPerWord && (cx * VRAM_CELL) % VRAM_PAGE_WIDTH * texelsPerWord + texelWidth > VRAM_PAGE_TEXELS)
+                    continue;
+                if (isFree(cx, cy, cw, ch)) {
+                    rect = VramRect{ cx * VRAM_CELL, cy * VRAM_CELL, cw * VRAM_CELL, ch * VRAM_CELL };
+                    mark(rect, true);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    size_t usedCells() const { return std::count(used.begin(), used.end(), uint8_t(1)); }
+
+    // Largest free rectangle in cells (largest rectangle under the per row histogram of free runs)
+    size_t largestFreeRect() const
+    {
+        std::vector<int> heights(VRAM_CELLS_X + 1, 0), stack;
+        size_t best = 0;
+        for (int y = 0; y < VRAM_CELLS_Y; y++) {
+            for (int x = 0; x < VRAM_CELLS_X; x++)
+                heights[x] = used[size_t(y) * VRAM_CELLS_X + x] ? 0 : heights[x] + 1;
+            stack.clear();
+            for (int x = 0; x <= VRAM_CELLS_X; x++) {
+                while (!stack.empty() && heights[stack.back()] >= heights[x]) {
+                    int h = heights[stack.back()];
+                    stack.pop_back();
+                    int left = stack.empty() ? 0 : stack.back() + 1;
+                    best = std::max(best, size_t(h) * (x - left));
+                }
+                stack.push_back(x);
+            }
+        }
+        return best;
+    }
+};
+
+struct VramPoolStats {
+    size_t uploads = 0, uploadedBytes = 0;
+    size_t evictions = 0;
+    size_t failures = 0; // use() calls that found no room
+};
+
+struct VramTexturePool {
+    struct Entry {
+        std::string path;
+        int width = 0, height = 0; // texels, after fitting into a page
+        VramDepth depth = VRAM_4BIT;
+        int wordWidth = 0;
+        std::vector<uint16_t> words; // main memory copy, wordWidth x height
+        std::vector<uint16_t> clut;  // empty for 15 bit
+        std::unique_ptr<VramTexture> texture;
+        bool resident = false;
+        VramRect rect = {};
+        int clutBlock = -1, clutLine = 0;
+        uint64_t lastUsed = 0; // frame
+        unsigned int refCount = 0;
+        bool reportedFailure = false;
+    };
+
+    // VRAM_CELL CLUTs of one depth, one per line; width 0 = free slot
+    struct ClutBlock {
+        VramRect rect = {};
+        VramDepth depth = VRAM_4BIT;
+        uint32_t usedLines = 0; // bit per line
+    };
+
+    std::vector<uint16_t> words = std::vector<uint16_t>(size_t(VRAM_WIDTH) * VRAM_HEIGHT, 0);
+    VramAllocator allocator;
+    std::vector<Entry> entries;
+    std::vector<int32_t> freeSlots;
+    std::unordered_map<std::string, int32_t> byPath;
+    std::vector<ClutBlock> clutBlocks;
+    size_t reservedCells = 0;
+
+    VramDepth depth = VRAM_4BIT;         // of textures loaded from now on
+    VramOverflow overflow = VRAM_EVICT;
+    ThreadPool* workers = nullptr;       // palettizing, optional
+    uint64_t frame = 1;
+    VramPoolStats stats;
+
+    // Keep rect out of the allocator (display area, ...)
+    void reserve(const VramRect& rect)
+    {
+        allocator.mark(rect, true);
+        reservedCells += size_t((rect.width + VRAM_CELL - 1) / VRAM_CELL) * ((rect.height + VRAM_CELL - 1) / VRAM_CELL);
+    }
+
+    // Reference the texture at path, loading it on first use; -1 if it cannot be loaded
+    int32_t acquire(const std::string& path)
+    {
+        auto it = byPath.find(path);
+        if (it != byPath.end()) {
+            entries[it->second].refCount++;
+            return it->second;
+        }
+
+        Entry entry;
+        if (!load(path, entry))
+            return -1;
+        return insert(std::move(entry));
+    }
+
+    // Same for an in-memory RGBA8 image (row 0 = v 0) registered under key
+    int32_t acquireImage(const std::string& key, const uint8_t* rgba, int width, int height)
+    {
+        auto it = byPath.find(key);
+        if (it != byPath.end()) {
+            entries[it->second].refCount++;
+            return it->second;
+        }
+
+        Entry entry;
+        pack(key, std::vector<uint8_t>(rgba, rgba + size_t(width) * height * 4), width, height, entry);
+        return insert(std::move(entry));
+    }
+
+    int32_t insert(Entry&& entry)
+    {
+        int32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            index = static_cast<int32_t>(entries.size());
+            entries.emplace_back();
+        }
+        entries[index] = std::move(entry);
+        entries[index].refCount = 1;
+        byPath[entries[index].path] = index;
+
+        // upload right away, so a full VRAM shows up at load time
+        if (!makeResident(entries[index]))
+            reportFailure(entries[index]);
+        return index;
+    }
+
+    void release(int32_t& index)
+    {
+        if (index < 0)
+            return;
+        Entry& entry = entries[index];
+        if (entry.refCount > 0 && --entry.refCount == 0) {
+            unload(entry);
+            byPath.erase(entry.path);
+            entry = Entry{};
+            freeSlots.push_back(index);
+        }
+        index = -1;
+    }
+
+    // Start of a frame, textures drawn in it are safe from eviction
+    void beginFrame() { frame++; }
+
+    // The texture for a draw this frame, uploaded again if it was evicted;
+    // nullptr if it is not loaded or there is no room
+    const VramTexture* use(int32_t index)
+    {
+        if (index < 0)
+            return nullptr;
+        Entry& entry = entries[index];
+        entry.lastUsed = frame;
+        if (!makeResident(entry)) {
+            stats.failures++;
+            reportFailure(entry);
+            return nullptr;
+        }
+        return entry.texture.get();
+    }
+
+    // Entry for the image file at path, false if it cannot be loaded
+    bool load(const std::string& path, Entry& entry)
+    {
+        stbi_set_flip_vertically_on_load(true); // v = 0 at the bottom, as in GL
+        int width, height, channels;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4); // force RGBA
+        if (!data) {
+            std::cerr << "VramTexturePool: cannot load " << path << "\n";
+            return false;
+        }
+        std::vector<uint8_t> rgba(data, data + size_t(width) * height * 4);
+        stbi_image_free(data);
+        pack(path, std::move(rgba), width, height, entry);
+        return true;
+    }
+
+    // RGBA image to packed words + CLUT, box filtered down to fit a page
+    void pack(const std::string& key, std::vector<uint8_t> rgba, int width, int height, Entry& entry)
+    {
+        std::vector<uint8_t> next;
+        while (width > VRAM_PAGE_TEXELS || height > VRAM_PAGE_HEIGHT) {
+            DownsampleRGBA(rgba.data(), width, height, next);
+            rgba.swap(next);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+
+        entry.path = key;
+        entry.width = width;
+        entry.height = height;
+        entry.depth = depth;
+        const int texelsPerWord = VramTexelsPerWord(depth), bits = 16 / texelsPerWord;
+        entry.wordWidth = (width + texelsPerWord - 1) / texelsPerWord;
+        entry.words.assign(size_t(entry.wordWidth) * height, 0);
+
+        if (depth == VRAM_15BIT) {
+            for (size_t i = 0; i < size_t(width) * height; i++) {
+                const uint8_t* p = &rgba[i * 4];
+                entry.words[i] = PackVramColor(p[0], p[1], p[2], p[3]);
+            }
+        } else {
+            PalettizedImage image;
+            PalettizeImage(rgba.data(), width, height, 1, VramClutColors(depth), image, workers);
+            for (uint32_t color : image.palette)
+                entry.clut.push_back(PackVramColor(ColorChannel(color, 0), ColorChannel(color, 1),
+                                                   ColorChannel(color, 2), ColorChannel(color, 3)));
+            const std::vector<uint8_t>& indices = image.levels[0];
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                    entry.words[size_t(y) * entry.wordWidth + x / texelsPerWord] |=
+                        static_cast<uint16_t>(indices[size_t(y) * width + x] << (x % texelsPerWord * bits));
+        }
+        entry.texture = std::make_unique<VramTexture>();
+    }
+
+    // Allocate and upload the entry if it isn't in VRAM, evicting as the policy allows
+    bool makeResident(Entry& entry)
+    {
+        if (entry.resident)
+            return true;
+
+        const int texelsPerWord = VramTexelsPerWord(entry.depth);
+        VramRect rect;
+        while (!allocator.allocate(entry.wordWidth, entry.height, texelsPerWord, entry.width, false, rect))
+            if (!evictOne())
+                return false;
+        while (!entry.clut.empty() && !allocateClut(entry))
+            if (!evictOne()) {
+                allocator.mark(rect, false);
+                return false;
+            }
+
+        for (int y = 0; y < entry.height; y++)
+            std::copy_n(&entry.words[size_t(y) * entry.wordWidth], entry.wordWidth,
+                        &words[size_t(rect.y + y) * VRAM_WIDTH + rect.x]);
+        VramTexture& texture = *entry.texture;
+        texture = VramTexture{ words.data(), rect.x, rect.y, entry.width, entry.height, entry.depth, 0, 0 };
+        if (!entry.clut.empty()) {
+            const ClutBlock& block = clutBlocks[entry.clutBlock];
+            texture.clutX = block.rect.x;
+            texture.clutY = block.rect.y + entry.clutLine;
+            std::copy(entry.clut.begin(), entry.clut.end(), &words[size_t(texture.clutY) * VRAM_WIDTH + texture.clutX]);
+        }
+        entry.rect = rect;
+        entry.resident = true;
+        stats.uploads++;
+        stats.uploadedBytes += (entry.words.size() + entry.clut.size()) * sizeof(uint16_t);
+        return true;
+    }
+
+    // A free CLUT line of the entry's depth, new blocks come from the bottom of VRAM
+    bool allocateClut(Entry& entry)
+    {
+        const uint32_t full = (1u << VRAM_CELL) - 1;
+        int freeBlock = -1;
+        for (size_t i = 0; i < clutBlocks.size(); i++) {
+            ClutBlock& block = clutBlocks[i];
+            if (block.rect.width == 0) {
+                freeBlock = static_cast<int>(i);
+            } else if (block.depth == entry.depth && block.usedLines != full) {
+                int line = 0;
+                while (block.usedLines & (1u << line))
+                    line++;
+                block.usedLines |= 1u << line;
+                entry.clutBlock = static_cast<int>(i);
+                entry.clutLine = line;
+                return true;
+            }
+        }
+
+        VramRect rect;
+        if (!allocator.allocate(int(entry.clut.size()), VRAM_CELL, 0, 0, true, rect))
+            return false;
+        if (freeBlock < 0) {
+            freeBlock = static_cast<int>(clutBlocks.size());
+            clutBlocks.emplace_back();
+        }
+        clutBlocks[freeBlock] = ClutBlock{ rect, entry.depth, 1u };
+        entry.clutBlock = freeBlock;
+        entry.clutLine = 0;
+        return true;
+    }
+
+    // Give back the entry's VRAM, its main memory copy stays
+    void unload(Entry& entry)
+    {
+        if (!entry.resident)
+            return;
+        allocator.mark(entry.rect, false);
+        if (entry.clutBlock >= 0) {
+            ClutBlock& block = clutBlocks[entry.clutBlock];
+            block.usedLines &= ~(1u << entry.clutLine);
+            if (block.usedLines == 0) {
+                allocator.mark(block.rect, false);
+                block = ClutBlock{};
+            }
+            entry.clutBlock = -1;
+        }
+        entry.resident = false;
+    }
+
+    // Evict the least recently drawn resident texture not drawn this frame
+    bool evictOne()
+    {
+        if (overflow != VRAM_EVICT)
+            return false;
+        Entry* oldest = nullptr;
+        for (Entry& entry : entries)
+            if (entry.resident && entry.lastUsed < frame && (!oldest || entry.lastUsed < oldest->lastUsed))
+                oldest = &entry;
+        if (!oldest)
+            return false;
+        unload(*oldest);
+        stats.evictions++;
+        return true;
+    }
+
+    void reportFailure(Entry& entry)
+    {
+        if (entry.reportedFailure)
+            return;
+        entry.reportedFailure = true;
+        std::cerr << "VramTexturePool: no room for " << entry.path << " (" << entry.width << "x" << entry.height
+                  << "), drawn untextured\n";
+    }
+
+    void printStats() const
+    {
+        size_t loaded = 0, resident = 0, textureCells = 0, textureWords = 0, clutCells = 0;
+        for (const Entry& entry : entries) {
+            if (!entry.texture)
+                continue;
+            loaded++;
+            if (entry.resident) {
+                resident++;
+                textureCells += size_t(entry.rect.width / VRAM_CELL) * (entry.rect.height / VRAM_CELL);
+                textureWords += entry.words.size();
+            }
+        }
+        for (const ClutBlock& block : clutBlocks)
+            clutCells += size_t(block.rect.width / VRAM_CELL) * (block.rect.height / VRAM_CELL);
+
+        const size_t cellBytes = VRAM_CELL * VRAM_CELL * sizeof(uint16_t);
+        const size_t totalCells = size_t(VRAM_CELLS_X) * VRAM_CELLS_Y;
+        size_t usedCells = allocator.usedCells(), freeCells = totalCells - usedCells;
+        double fragmentation = freeCells ? 1.0 - double(allocator.largestFreeRect()) / freeCells : 0.0;
+        std::cout << "VRAM: " << resident << " of " << loaded << " textures resident, " << usedCells * 100 / totalCells
+                  << "% used (textures " << textureCells * cellBytes / 1024 << " KB, "
+                  << (textureCells * cellBytes - textureWords * sizeof(uint16_t)) / 1024 << " KB of it cell padding, CLUTs "
+                  << clutCells * cellBytes / 1024 << " KB, reserved " << reservedCells * cellBytes / 1024
+                  << " KB), " << freeCells * cellBytes / 1024 << " KB free, fragmentation "
+                  << int(fragmentation * 100.0) << "%, " << stats.uploads << " uploads ("
+                  << stats.uploadedBytes / 1024 << " KB), " << stats.evictions << " evictions, " << stats.failures
+                  << " failed draws\n";
+    }
+};